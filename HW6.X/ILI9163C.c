@@ -13,10 +13,53 @@
 
 // B8 is turned into SDI1 but is not used or connected to anything
 
+// bulk pixel data goes out through DMA channel 0, triggered by the spi1 tx interrupt
+// with spi1 switched to 16 bit words, so CS stays low for a whole address window
+
 #include <xc.h>
+#include <sys/attribs.h>
+#include <sys/kmem.h>
 #include "ILI9163C.h"
 
-void SPI1_init() {
+unsigned long LCD_spiBytes = 0;
+unsigned long LCD_pixels = 0;
+
+#if LCD_FRAMEBUFFER
+static unsigned char framebuffer[_GRAMSIZE/2]; // two pixels per byte, even x in the low nibble
+static unsigned short palette[LCD_PALETTE_SIZE];
+static unsigned char paletteUsed = 0;
+
+typedef struct {
+    unsigned short x0, y0, x1, y1;
+} LCD_RECT;
+
+static LCD_RECT dirty[LCD_DIRTY_MAX];
+static unsigned char dirtyCount = 0;
+#endif
+
+// state of the block started by LCD_beginWindow
+static unsigned short winX0, winX1, winX, winY;
+
+static unsigned char busMode = LCD_BUS_DMA; // how pixels are sent, set by SPI1_init
+
+// DMA transfer state, rows are sent out of two line buffers while the next one is filled
+static volatile unsigned char dmaBusy = 0;
+static void (*dmaDone)(void) = 0;
+static unsigned short lineBuf[2][_GRAMWIDTH];
+static unsigned short dmaRows; // rows left after the one being sent
+static unsigned short dmaRowLen; // pixels per row
+#if LCD_FRAMEBUFFER
+static unsigned char lineNext; // lineBuf holding the next row to send
+static LCD_RECT flushRects[LCD_DIRTY_MAX]; // rectangles being sent by LCD_flushAsync
+static unsigned char flushCount, flushIndex;
+static unsigned short flushY; // next framebuffer row to put in a line buffer
+#endif
+
+static void LCD_sendAddr(unsigned short, unsigned short, unsigned short, unsigned short);
+
+void SPI1_init(unsigned char mode) {
+    busMode = mode;
+
 	SDI1Rbits.SDI1R = 0b0100; // B8 is SDI1
     RPA1Rbits.RPA1R = 0b0011; // A1 is SDO1
     TRISBbits.TRISB7 = 0; // SS is B7
@@ -34,9 +77,219 @@ void SPI1_init() {
     SPI1CONbits.CKE = 1; // data changes when clock goes from hi to lo (since CKP is 0)
     SPI1CONbits.MSTEN = 1; // master operation
     SPI1CONbits.ON = 1; // turn on spi1
+
+    // DMA channel 0 moves one 16 bit pixel into SPI1BUF each time there is room
+    DMACONbits.ON = 1;
+    DCH0CON = 0;
+    DCH0CONbits.CHPRI = 3; // highest priority
+    DCH0ECON = 0;
+    DCH0ECONbits.CHSIRQ = _SPI1_TX_IRQ; // start a cell transfer on the spi1 tx interrupt
+    DCH0ECONbits.SIRQEN = 1;
+    DCH0DSA = KVA_TO_PA(&SPI1BUF);
+    DCH0DSIZ = 2;
+    DCH0CSIZ = 2;
+    DCH0INTCLR = 0x00FF00FF; // clear the flags and the enables
+    DCH0INTbits.CHBCIE = 1; // interrupt when the block is done
+    IPC10bits.DMA0IP = 5;
+    IFS1bits.DMA0IF = 0;
+    IEC1bits.DMA0IE = 1;
+
+    // the spi1 interrupt ends a DMA transfer once the fifo has drained, see LCD_dmaDrain
+    IEC1bits.SPI1TXIE = 0;
+    IPC7bits.SPI1IP = 5; // same as the DMA, so one never interrupts the other
+}
+
+// switch spi1 between 8 bit bytes for commands and 16 bit words for pixels
+// the mode can only be changed with the module off, so wait for the last word first
+static void SPI1_mode16(unsigned char on) {
+    while (SPI1STATbits.SPIBUSY) { ; }
+    SPI1CONbits.ON = 0;
+    SPI1CONbits.MODE16 = on;
+    SPI1CONbits.ENHBUF = on; // 8 deep fifo for the DMA to keep full
+    SPI1CONbits.STXISEL = on ? 0b11 : 0b00; // tx interrupt while the fifo is not full
+    SPI1STATbits.SPIROV = 0; // nothing reads the rx side while streaming
+    SPI1CONbits.ON = 1;
+    while (!SPI1STATbits.SPIRBE) { // clear the rx buffer
+        SPI1BUF;
+    }
+}
+
+// send bytes from a line buffer
+// the spi1 tx interrupt moves a pixel each time the fifo goes from full to having room. a row
+// started from the DMA interrupt finds the fifo still full of the last row, so it is left to
+// that. the first row of a window finds it empty, and no interrupt would come, so its first
+// cell is forced. a forced cell is only safe with room for it, which empty is sure to have
+static void LCD_dmaStart(const unsigned short *buf, unsigned short count) {
+    dmaRowLen = count;
+    DCH0SSA = KVA_TO_PA(buf);
+    DCH0SSIZ = count*2;
+    DCH0INTCLR = 0x000000FF;
+    DCH0CONbits.CHEN = 1;
+    LCD_spiBytes += count*2;
+    if (SPI1STATbits.SPITBE) {
+        DCH0ECONbits.CFORCE = 1;
+    }
+}
+
+// the last pixel of a window went into the fifo, finish the transfer
+static void LCD_dmaFinish(void) {
+    SPI1_mode16(0); // waits for the fifo to drain
+    LATBbits.LATB7 = 1; // CS
+}
+
+// the last pixel of a DMA transfer went into the fifo. rather than wait the ~10 us for the fifo
+// to drain in the DMA interrupt, the spi1 tx interrupt is set to come when the last word has
+// been shifted out, and it finishes the transfer
+static void LCD_dmaDrain(void) {
+    SPI1CONbits.STXISEL = 0b00; // tx interrupt when the fifo and the shift register are empty
+    IFS1bits.SPI1TXIF = 0;
+    IEC1bits.SPI1TXIE = 1;
+    if (SPI1STATbits.SPITBE && !SPI1STATbits.SPIBUSY) {
+        IFS1bits.SPI1TXIF = 1; // it drained before the flag was cleared
+    }
+}
+
+#if !LCD_FRAMEBUFFER
+// 16 bit fifo stream from the CPU, for LCD_BUS_FIFO and for the small blocks in LCD_BUS_DMA
+// call after LCD_sendAddr, which leaves CS low and DAT high
+static void LCD_streamBegin(void) {
+    SPI1_mode16(1);
+}
+
+static inline void LCD_streamPixel(unsigned short color) {
+    while (SPI1STATbits.SPITBF) { ; } // wait for room in the fifo, not for the word to go out
+    SPI1BUF = color;
+}
+
+static void LCD_streamRepeat(unsigned short color, unsigned long n) {
+    LCD_spiBytes += n*2;
+    while (n--) {
+        LCD_streamPixel(color);
+    }
+}
+#endif
+
+#if LCD_FRAMEBUFFER
+// turn a framebuffer row of the current flush rectangle into pixels
+static void LCD_fbRow(unsigned short *buf) {
+    LCD_RECT *r = &flushRects[flushIndex];
+    unsigned int p = flushY*_GRAMWIDTH + r->x0;
+    unsigned short x;
+    unsigned char b;
+
+    for (x = r->x0; x <= r->x1; x++, p++) {
+        b = framebuffer[p>>1];
+        *buf++ = palette[(p & 1) ? (b >> 4) : (b & 0x0F)];
+    }
+    flushY++;
+}
+
+// set the address window for the next flush rectangle and start its first row
+static void LCD_fbRectStart(void) {
+    LCD_RECT *r = &flushRects[flushIndex];
+
+    LCD_sendAddr(r->x0, r->y0, r->x1, r->y1); // leaves CS low and DAT high
+    SPI1_mode16(1);
+    flushY = r->y0;
+    LCD_fbRow(lineBuf[0]);
+    dmaRows = r->y1 - r->y0;
+    lineNext = 1;
+    LCD_dmaStart(lineBuf[0], r->x1 - r->x0 + 1);
+    if (dmaRows) {
+        LCD_fbRow(lineBuf[1]);
+    }
+}
+#endif
+
+void __ISR(_DMA_0_VECTOR, IPL5SOFT) DMA0ISR(void) {
+    DCH0INTCLR = 0x000000FF;
+    IFS1bits.DMA0IF = 0;
+
+    if (dmaRows) { // more rows in this window
+        dmaRows--;
+#if LCD_FRAMEBUFFER
+        if (flushCount) {
+            LCD_dmaStart(lineBuf[lineNext], dmaRowLen);
+            lineNext ^= 1;
+            if (dmaRows) {
+                LCD_fbRow(lineBuf[lineNext]);
+            }
+            return;
+        }
+#endif
+        LCD_dmaStart(lineBuf[0], dmaRowLen); // a fill sends the same row again
+        return;
+    }
+
+    LCD_dmaDrain();
+}
+
+void __ISR(_SPI_1_VECTOR, IPL5SOFT) SPI1ISR(void) {
+    void (*done)(void);
+
+    IEC1bits.SPI1TXIE = 0;
+    IFS1bits.SPI1TXIF = 0;
+
+    LCD_dmaFinish(); // the fifo is empty, so this does not wait
+#if LCD_FRAMEBUFFER
+    if (flushCount) {
+        if (++flushIndex < flushCount) { // on to the next rectangle
+            LCD_fbRectStart();
+            return;
+        }
+        flushCount = 0;
+    }
+#endif
+    done = dmaDone;
+    dmaDone = 0;
+    dmaBusy = 0;
+    if (done) {
+        done();
+    }
+}
+
+int LCD_busy(void) {
+    return dmaBusy;
+}
+
+void LCD_wait(void) {
+    while (dmaBusy) { ; }
 }
 
+void LCD_writePixels(const unsigned short *buf, unsigned short count, void (*done)(void)) {
+    LCD_wait();
+    if (count == 0) {
+        if (done) {
+            done();
+        }
+        return;
+    }
+    dmaBusy = 1;
+    dmaDone = done;
+    dmaRows = 0;
+    LATBbits.LATB15 = 1; // DAT
+    LATBbits.LATB7 = 0; // CS, held low until the DMA is done
+    SPI1_mode16(1);
+    LCD_dmaStart(buf, count);
+}
+
+#if !LCD_FRAMEBUFFER
+// send the same color to every pixel of the window set by LCD_sendAddr
+static void LCD_fillWindow(unsigned short color, unsigned short width, unsigned short height) {
+    int i;
+    for (i = 0; i < width; i++) {
+        lineBuf[0][i] = color;
+    }
+    dmaBusy = 1;
+    dmaDone = 0;
+    dmaRows = height - 1;
+    SPI1_mode16(1);
+    LCD_dmaStart(lineBuf[0], width);
+}
+#endif
+
 unsigned char spi_io(unsigned char o) {
+  LCD_spiBytes++;
   SPI1BUF = o;
   while(!SPI1STATbits.SPIRBF) { // wait to receive the byte
     ;
@@ -45,6 +298,7 @@ unsigned char spi_io(unsigned char o) {
 }
 
 void LCD_command(unsigned char com) {
+    LCD_wait();
     LATBbits.LATB15 = 0; // DAT
     LATBbits.LATB7 = 0; // CS
     spi_io(com);
@@ -52,6 +306,7 @@ void LCD_command(unsigned char com) {
 }
 
 void LCD_data(unsigned char dat) {
+    LCD_wait();
     LATBbits.LATB15 = 1; // DAT
     LATBbits.LATB7 = 0; // CS
     spi_io(dat);
@@ -59,6 +314,7 @@ void LCD_data(unsigned char dat) {
 }
 
 void LCD_data16(unsigned short dat) {
+    LCD_wait();
     LATBbits.LATB15 = 1; // DAT
     LATBbits.LATB7 = 0; // CS
     spi_io(dat>>8);
@@ -164,82 +420,589 @@ void LCD_init() {
 	LCD_command(CMD_RAMWR);//Memory Write
 }
 
+// rows top to top+height-1 of the LCD memory scroll, the rows above and below stay put
+void LCD_scrollArea(unsigned short top, unsigned short height) {
+    if (top >= _GRAMHEIGH) {
+        top = _GRAMHEIGH - 1;
+    }
+    if (height > _GRAMHEIGH - top) {
+        height = _GRAMHEIGH - top;
+    }
+    LCD_command(CMD_VSCLLDEF);
+    LCD_data16(top); // fixed rows at the top
+    LCD_data16(height); // scrolling rows
+    LCD_data16(_GRAMHEIGH - top - height); // fixed rows at the bottom
+}
+
+// show LCD memory row line at the top of the scroll area, the rows after it wrap around
+// inside the area, so moving this by one text row scrolls the area without sending pixels
+void LCD_scrollTo(unsigned short line) {
+    LCD_command(CMD_VSSTADRS);
+    LCD_data16(line);
+}
+
+#if LCD_FRAMEBUFFER
+// find the palette entry for a color, adding it if there is room
+static unsigned char LCD_colorIndex(unsigned short color) {
+    static unsigned char last = 0;
+    int i, best = 0;
+    long d, bestD = 0x7FFFFFFF;
+
+    if (paletteUsed && palette[last] == color) {
+        return last;
+    }
+    for (i = 0; i < paletteUsed; i++) {
+        if (palette[i] == color) {
+            last = i;
+            return i;
+        }
+    }
+    if (paletteUsed < LCD_PALETTE_SIZE) {
+        palette[paletteUsed] = color;
+        last = paletteUsed;
+        return paletteUsed++;
+    }
+    // palette is full, use the closest color
+    for (i = 0; i < LCD_PALETTE_SIZE; i++) {
+        int dr = (int)(palette[i] >> 11) - (int)(color >> 11);
+        int dg = (int)((palette[i] >> 5) & 0x3F) - (int)((color >> 5) & 0x3F);
+        int db = (int)(palette[i] & 0x1F) - (int)(color & 0x1F);
+        d = (long)dr*dr*4 + (long)dg*dg + (long)db*db*4;
+        if (d < bestD) {
+            bestD = d;
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void LCD_fbSet(unsigned short x, unsigned short y, unsigned char index) {
+    unsigned int i = y*_GRAMWIDTH + x;
+    if (i & 1) {
+        framebuffer[i>>1] = (framebuffer[i>>1] & 0x0F) | (index << 4);
+    } else {
+        framebuffer[i>>1] = (framebuffer[i>>1] & 0xF0) | index;
+    }
+}
+#endif
+
 void LCD_drawPixel(unsigned short x, unsigned short y, unsigned short color) {
-    // check boundary
-    LCD_setAddr(x,y,x+1,y+1);
-    LCD_data16(color);
+#if LCD_FRAMEBUFFER
+    if (x >= _GRAMWIDTH || y >= _GRAMHEIGH) {
+        return;
+    }
+    LCD_fbSet(x, y, LCD_colorIndex(color));
+    LCD_markDirty(x, y, x, y);
+#else
+    if (busMode == LCD_BUS_BYTE) {
+        // check boundary
+        LCD_setAddr(x,y,x+1,y+1);
+        LCD_data16(color);
+    } else { // address and pixel in one CS frame
+        LCD_wait();
+        LCD_sendAddr(x, y, x, y);
+        spi_io(color>>8);
+        spi_io(color);
+        LATBbits.LATB7 = 1; // CS
+    }
+#endif
 }
 
 void LCD_setAddr(unsigned short x0, unsigned short y0, unsigned short x1, unsigned short y1) {
-    LCD_command(CMD_CLMADRS); // Column
-    LCD_data16(x0);
-	LCD_data16(x1);
+    LCD_wait();
+    LCD_sendAddr(x0, y0, x1, y1);
+    LATBbits.LATB7 = 1; // CS
+}
 
-	LCD_command(CMD_PGEADRS); // Page
-	LCD_data16(y0);
-	LCD_data16(y1);
+// set the address window in one CS frame, leaving CS low and DAT high for the pixels
+// the LCD samples DAT with the last bit of each byte, so it can change between bytes
+static void LCD_sendAddr(unsigned short x0, unsigned short y0, unsigned short x1, unsigned short y1) {
+    LATBbits.LATB7 = 0; // CS
+    LATBbits.LATB15 = 0; // command
+    spi_io(CMD_CLMADRS); // Column
+    LATBbits.LATB15 = 1; // data
+    spi_io(x0>>8);
+    spi_io(x0);
+    spi_io(x1>>8);
+    spi_io(x1);
 
-	LCD_command(CMD_RAMWR); //Into RAM
+    LATBbits.LATB15 = 0;
+    spi_io(CMD_PGEADRS); // Page
+    LATBbits.LATB15 = 1;
+    spi_io(y0>>8);
+    spi_io(y0);
+    spi_io(y1>>8);
+    spi_io(y1);
+
+    LATBbits.LATB15 = 0;
+    spi_io(CMD_RAMWR); //Into RAM
+    LATBbits.LATB15 = 1;
 }
 
 void LCD_clearScreen(unsigned short color) {
+#if LCD_FRAMEBUFFER
     int i;
-    LCD_setAddr(0,0,_GRAMWIDTH,_GRAMHEIGH);
+    unsigned char index;
+    paletteUsed = 0; // nothing else is on the screen, start the palette over
+    index = LCD_colorIndex(color);
+    for (i = 0; i < _GRAMSIZE/2; i++) {
+        framebuffer[i] = index | (index << 4);
+    }
+    dirtyCount = 0;
+    LCD_markDirty(0, 0, _GRAMWIDTH-1, _GRAMHEIGH-1);
+#else
+    if (busMode == LCD_BUS_BYTE) {
+        int i;
+        LCD_setAddr(0,0,_GRAMWIDTH,_GRAMHEIGH);
 		for (i = 0;i < _GRAMSIZE; i++){
 			LCD_data16(color);
 		}
+    } else {
+        LCD_fillRect(0, 0, _GRAMWIDTH, _GRAMHEIGH, color);
+        LCD_wait();
+    }
+#endif
 }
 
+void LCD_beginWindow(unsigned short x0, unsigned short y0, unsigned short x1, unsigned short y1) {
+    winX0 = x0;
+    winX1 = x1;
+    winX = x0;
+    winY = y0;
+#if LCD_FRAMEBUFFER
+    LCD_markDirty(x0, y0, x1, y1);
+#else
+    if (busMode == LCD_BUS_BYTE) {
+        LCD_setAddr(x0, y0, x1, y1);
+    } else {
+        LCD_wait();
+        LCD_sendAddr(x0, y0, x1, y1);
+        LCD_streamBegin();
+    }
+#endif
+}
 
-// Draw characters to the LCD
-void LCD_drawChar(unsigned short xStart, unsigned short yStart, char symbol){
-    int set, xpos, ypos, asciiIndex;
-    int row;       // keeps track of row, 8 rows per character
-    char bitMap;   // char design
-    int column;    // keeps track of column, 5 coumns per character
-    asciiIndex = (int)(symbol - 32);
-    
-    // Iterate over each of the 5 columns
-    for (column = 0;column<5;column++){
-        row = 0;
-        bitMap = ASCII[asciiIndex][column];
-        // Iterate over each of the 8 rows per column
-        for (row=0;row < 8;row++){
-            set = (bitMap >> row) & 0x01;
-            xpos = xStart + column;   // x coordinate of pixel
-            ypos = yStart + row;      // y coordinate of pixel
-            
-            // Check if pixel exists on LCD, draw only if it does
-            if (xpos <= 128 && ypos <= 128) {
-                if (set) {
-                    LCD_drawPixel(xpos, ypos, RED);  // text
-                } else {
-                    LCD_drawPixel(xpos, ypos, BLACK); // background
+void LCD_pushColor(unsigned short color) {
+#if LCD_FRAMEBUFFER
+    if (winX < _GRAMWIDTH && winY < _GRAMHEIGH) {
+        LCD_fbSet(winX, winY, LCD_colorIndex(color));
+    }
+    if (winX == winX1) { // wrap to the next row of the block, like the LCD does
+        winX = winX0;
+        winY++;
+    } else {
+        winX++;
+    }
+#else
+    if (busMode == LCD_BUS_BYTE) {
+        LCD_data16(color);
+    } else {
+        LCD_streamPixel(color);
+        LCD_spiBytes += 2;
+    }
+#endif
+}
+
+void LCD_endWindow(void) {
+#if !LCD_FRAMEBUFFER
+    if (busMode != LCD_BUS_BYTE) {
+        LCD_dmaFinish(); // wait for the fifo to empty and raise CS
+    }
+#endif
+}
+
+void LCD_fillRect(unsigned short x, unsigned short y, unsigned short w, unsigned short h, unsigned short color) {
+    if (x >= _GRAMWIDTH || y >= _GRAMHEIGH || w == 0 || h == 0) {
+        return;
+    }
+    if (x + w > _GRAMWIDTH) {
+        w = _GRAMWIDTH - x;
+    }
+    if (y + h > _GRAMHEIGH) {
+        h = _GRAMHEIGH - y;
+    }
+    LCD_pixels += (unsigned long)w * h;
+#if LCD_FRAMEBUFFER
+    {
+        unsigned short i, j;
+        unsigned char index = LCD_colorIndex(color);
+        for (j = y; j < y + h; j++) {
+            for (i = x; i < x + w; i++) {
+                LCD_fbSet(i, j, index);
+            }
+        }
+        LCD_markDirty(x, y, x + w - 1, y + h - 1);
+    }
+#else
+    if (busMode == LCD_BUS_BYTE) {
+        unsigned long n = (unsigned long)w * h;
+        LCD_setAddr(x, y, x + w - 1, y + h - 1);
+        while (n--) {
+            LCD_data16(color);
+        }
+    } else if (busMode == LCD_BUS_FIFO || w * h < 32) { // not worth setting up the DMA
+        LCD_wait();
+        LCD_sendAddr(x, y, x + w - 1, y + h - 1);
+        LCD_streamBegin();
+        LCD_streamRepeat(color, (unsigned long)w * h);
+        LCD_dmaFinish();
+    } else {
+        LCD_wait();
+        LCD_sendAddr(x, y, x + w - 1, y + h - 1);
+        LCD_fillWindow(color, w, h); // returns while the DMA runs
+    }
+#endif
+}
+
+// fillRect with signed corners, the part off the top or left of the LCD is cut off
+static void LCD_span(int x, int y, int w, int h, unsigned short color) {
+    if (x < 0) {
+        w += x;
+        x = 0;
+    }
+    if (y < 0) {
+        h += y;
+        y = 0;
+    }
+    if (w > 0 && h > 0) {
+        LCD_fillRect(x, y, w, h, color);
+    }
+}
+
+void LCD_hline(unsigned short x, unsigned short y, unsigned short w, unsigned short color) {
+    LCD_fillRect(x, y, w, 1, color);
+}
+
+void LCD_vline(unsigned short x, unsigned short y, unsigned short h, unsigned short color) {
+    LCD_fillRect(x, y, 1, h, color);
+}
+
+// Bresenham, the pixels of each step along the minor axis go out as one span
+void LCD_drawLine(short x0, short y0, short x1, short y1, unsigned short color) {
+    int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+    int dy = y1 > y0 ? y1 - y0 : y0 - y1;
+    int t, err, start;
+
+    if (dx >= dy) {
+        if (x0 > x1) { // always go left to right
+            t = x0; x0 = x1; x1 = t;
+            t = y0; y0 = y1; y1 = t;
+        }
+        err = dx / 2;
+        start = x0;
+        for (; x0 <= x1; x0++) {
+            err -= dy;
+            if (err < 0 || x0 == x1) { // the row changes after this pixel
+                LCD_span(start, y0, x0 - start + 1, 1, color);
+                start = x0 + 1;
+                y0 += y1 > y0 ? 1 : -1;
+                err += dx;
+            }
+        }
+    } else {
+        if (y0 > y1) { // always go top to bottom
+            t = x0; x0 = x1; x1 = t;
+            t = y0; y0 = y1; y1 = t;
+        }
+        err = dy / 2;
+        start = y0;
+        for (; y0 <= y1; y0++) {
+            err -= dx;
+            if (err < 0 || y0 == y1) { // the column changes after this pixel
+                LCD_span(x0, start, 1, y0 - start + 1, color);
+                start = y0 + 1;
+                x0 += x1 > x0 ? 1 : -1;
+                err += dy;
+            }
+        }
+    }
+}
+
+// Midpoint circle, walking the octant from the top going right. x goes up every step and y
+// sometimes goes down, so each y gives a run of x that is a horizontal span at the top and
+// bottom of the circle and a vertical span at the sides
+static void LCD_circle(short cx, short cy, short r, unsigned short color, unsigned char fill) {
+    int x = 0, y = r, d = 1 - r, start = 0, i;
+
+    if (r < 0) {
+        return;
+    }
+    while (x <= y) {
+        int yNext = y;
+        if (d < 0) {
+            d += 2*x + 3;
+        } else {
+            d += 2*(x - y) + 5;
+            yNext--;
+        }
+        if (yNext != y || x + 1 > yNext) { // end of the run of x at this y
+            int n = x - start + 1;
+            if (fill) {
+                // rows across the middle for each x of the run, and one across the top and bottom
+                for (i = start; i <= x; i++) {
+                    LCD_span(cx - y, cy + i, 2*y + 1, 1, color);
+                    if (i != 0) {
+                        LCD_span(cx - y, cy - i, 2*y + 1, 1, color);
+                    }
+                }
+                if (y > x) {
+                    LCD_span(cx - x, cy + y, 2*x + 1, 1, color);
+                    LCD_span(cx - x, cy - y, 2*x + 1, 1, color);
                 }
+            } else {
+                LCD_span(cx + start, cy + y, n, 1, color);
+                LCD_span(cx - x, cy + y, n, 1, color);
+                LCD_span(cx + start, cy - y, n, 1, color);
+                LCD_span(cx - x, cy - y, n, 1, color);
+                LCD_span(cx + y, cy + start, 1, n, color);
+                LCD_span(cx + y, cy - x, 1, n, color);
+                LCD_span(cx - y, cy + start, 1, n, color);
+                LCD_span(cx - y, cy - x, 1, n, color);
+            }
+            start = x + 1;
+        }
+        x++;
+        y = yNext;
+    }
+}
+
+void LCD_drawCircle(short cx, short cy, short r, unsigned short color) {
+    LCD_circle(cx, cy, r, color, 0);
+}
+
+void LCD_fillCircle(short cx, short cy, short r, unsigned short color) {
+    LCD_circle(cx, cy, r, color, 1);
+}
+
+void LCD_markDirty(unsigned short x0, unsigned short y0, unsigned short x1, unsigned short y1) {
+#if LCD_FRAMEBUFFER
+    int i, best = 0;
+    long grow, bestGrow = 0x7FFFFFFF;
+    LCD_RECT *r;
+
+    if (x0 >= _GRAMWIDTH || y0 >= _GRAMHEIGH) {
+        return;
+    }
+    if (x1 >= _GRAMWIDTH) {
+        x1 = _GRAMWIDTH-1;
+    }
+    if (y1 >= _GRAMHEIGH) {
+        y1 = _GRAMHEIGH-1;
+    }
+
+    // grow a rectangle that overlaps or touches this one
+    for (i = 0; i < dirtyCount; i++) {
+        r = &dirty[i];
+        if (x0 <= r->x1+1 && x1+1 >= r->x0 && y0 <= r->y1+1 && y1+1 >= r->y0) {
+            break;
+        }
+    }
+    if (i == dirtyCount) {
+        if (dirtyCount < LCD_DIRTY_MAX) { // start a new one
+            r = &dirty[dirtyCount++];
+            r->x0 = x0; r->y0 = y0; r->x1 = x1; r->y1 = y1;
+            return;
+        }
+        // out of rectangles, merge into the one that grows the least
+        for (i = 0; i < dirtyCount; i++) {
+            r = &dirty[i];
+            grow = (long)((x1 > r->x1 ? x1 : r->x1) - (x0 < r->x0 ? x0 : r->x0) + 1)
+                 * ((y1 > r->y1 ? y1 : r->y1) - (y0 < r->y0 ? y0 : r->y0) + 1)
+                 - (long)(r->x1 - r->x0 + 1) * (r->y1 - r->y0 + 1);
+            if (grow < bestGrow) {
+                bestGrow = grow;
+                best = i;
+            }
+        }
+        i = best;
+    }
+    r = &dirty[i];
+    if (x0 < r->x0) r->x0 = x0;
+    if (y0 < r->y0) r->y0 = y0;
+    if (x1 > r->x1) r->x1 = x1;
+    if (y1 > r->y1) r->y1 = y1;
+#endif
+}
+
+void LCD_flush(void) {
+    LCD_flushAsync(0);
+    LCD_wait();
+}
+
+void LCD_flushAsync(void (*done)(void)) {
+#if LCD_FRAMEBUFFER
+    int i;
+
+    LCD_wait();
+    if (dirtyCount == 0) {
+        if (done) {
+            done();
+        }
+        return;
+    }
+    // take the dirty list, anything drawn from now on goes into the next flush
+    for (i = 0; i < dirtyCount; i++) {
+        flushRects[i] = dirty[i];
+    }
+    flushCount = dirtyCount;
+    flushIndex = 0;
+    dirtyCount = 0;
+    dmaBusy = 1;
+    dmaDone = done;
+    LCD_fbRectStart();
+#else
+    if (done) {
+        done();
+    }
+#endif
+}
+
+
+// Glyph for a character, unknown characters are drawn as a space
+static const char *LCD_glyph(char symbol) {
+    int asciiIndex = (int)(symbol - 32);
+    if (asciiIndex < 0 || asciiIndex >= 96) {
+        asciiIndex = 0;
+    }
+    return ASCII[asciiIndex];
+}
+
+// Send up to n characters as one 6x8 per character block, the 6th column is the spacing
+static void LCD_blitText(unsigned short left, unsigned short top, const char *text, int n, unsigned short fg, unsigned short bg) {
+    const char *glyphs[_GRAMWIDTH/6 + 1];
+    int width, row, column, i;
+
+    // Check if the text is on the LCD, cut off the characters that run past the edge
+    if (left >= _GRAMWIDTH || top + 7 >= _GRAMHEIGH || n <= 0) {
+        return;
+    }
+    width = 6*n;
+    if (left + width > _GRAMWIDTH) {
+        width = _GRAMWIDTH - left;
+        n = (width + 5) / 6;
+    }
+    for (i = 0; i < n; i++) {
+        glyphs[i] = LCD_glyph(text[i]);
+    }
+
+    LCD_beginWindow(left, top, left + width - 1, top + 7);
+    for (row = 0; row < 8; row++) {
+        for (column = 0; column < width; column++) {
+            i = column % 6;
+            if (i < 5 && ((glyphs[column / 6][i] >> row) & 0x01)) {
+                LCD_pushColor(fg);  // text
+            } else {
+                LCD_pushColor(bg); // background and spacing
             }
         }
-        
     }
+    LCD_endWindow();
+}
+
+// Draw characters to the LCD
+void LCD_drawChar(unsigned short xStart, unsigned short yStart, char symbol){
+    LCD_drawCharColor(xStart, yStart, symbol, RED, BLACK);
+}
+
+void LCD_drawCharColor(unsigned short xStart, unsigned short yStart, char symbol, unsigned short fg, unsigned short bg){
+    LCD_blitText(xStart, yStart, &symbol, 1, fg, bg);
 }
 
 // Draw strings to the LCD
 void LCD_drawString(unsigned short left, unsigned short top, char *text){
-    int ii=0;
-    int xpos=left;
-   
-    while (text[ii]!=0){
+    LCD_drawStringColor(left, top, text, RED, BLACK);
+}
+
+// Each line of the string goes out as one block
+void LCD_drawStringColor(unsigned short left, unsigned short top, const char *text, unsigned short fg, unsigned short bg){
+    int n;
+
+    while (*text != 0){
+        for (n = 0; text[n] != 0 && text[n] != '\n'; n++) {
+            ;
+        }
+        LCD_blitText(left, top, text, n, fg, bg);
+        text += n;
+
         // Identify if new line character, if so jump down 10 pixels and start at left
-        if (text[ii]=='\n'){
+        if (*text == '\n'){
             top = top + 10;
-            xpos = left;
-            ii++;
-            continue;
-        }
-        
-        LCD_drawChar(xpos,top,text[ii]);  // Draw the character on the LCD
-        xpos = xpos + 6; // increment to starting spot for next char, 1px spacing
-        
-        ii++;  // increment
-        
-    }
-}
\ No newline at end of file
+            text++;
+        }
+    }
+}
+
+// Decode the runs of a sprite straight into one block, pixels past the right or bottom edge are skipped
+void LCD_drawSprite(unsigned short x, unsigned short y, const LCD_SPRITE *sprite) {
+    const unsigned char *p = sprite->data;
+    unsigned short w = sprite->width, h = sprite->height;
+    unsigned short visW, visH, col = 0, row = 0, n, run;
+    unsigned char b;
+#if LCD_FRAMEBUFFER
+    unsigned char index[LCD_PALETTE_SIZE];
+    unsigned short i;
+#else
+    unsigned short color;
+#endif
+
+    if (x >= _GRAMWIDTH || y >= _GRAMHEIGH || w == 0 || h == 0) {
+        return;
+    }
+    visW = x + w > _GRAMWIDTH ? _GRAMWIDTH - x : w;
+    visH = y + h > _GRAMHEIGH ? _GRAMHEIGH - y : h;
+
+#if LCD_FRAMEBUFFER
+    // look the colors up once instead of for every pixel
+    for (i = 0; i < sprite->colors && i < LCD_PALETTE_SIZE; i++) {
+        index[i] = LCD_colorIndex(sprite->palette[i]);
+    }
+    LCD_markDirty(x, y, x + visW - 1, y + visH - 1);
+#else
+    LCD_beginWindow(x, y, x + visW - 1, y + visH - 1);
+#endif
+
+    while (row < visH) {
+        b = *p++;
+        run = (b >> 4) + 1;
+        if (run == 16) {
+            run += *p++;
+        }
+        b &= 0x0F;
+#if !LCD_FRAMEBUFFER
+        color = sprite->palette[b];
+#endif
+        // a run can go over the end of a row, split it so the clipped part is not sent
+        while (run != 0 && row < visH) {
+            n = w - col;
+            if (n > run) {
+                n = run;
+            }
+            if (col < visW) {
+                unsigned short m = col + n > visW ? visW - col : n;
+#if LCD_FRAMEBUFFER
+                for (i = 0; i < m; i++) {
+                    LCD_fbSet(x + col + i, y + row, index[b]);
+                }
+#else
+                if (busMode == LCD_BUS_BYTE) {
+                    while (m--) {
+                        LCD_data16(color);
+                    }
+                } else {
+                    LCD_streamRepeat(color, m);
+                }
+#endif
+            }
+            col += n;
+            run -= n;
+            if (col == w) {
+                col = 0;
+                row++;
+            }
+        }
+    }
+
+#if !LCD_FRAMEBUFFER
+    LCD_endWindow();
+#endif
+}
@@ -156,6 +156,15 @@ static const char ASCII[96][5] = {
 #define _GRAMHEIGH 128 //160
 #define _GRAMSIZE  _GRAMWIDTH * _GRAMHEIGH
 
+// set to 1 (here or in the project's macros) to draw into an in-RAM framebuffer and send only the changed areas with LCD_flush()
+// a full RGB565 frame is 32KB, all of the PIC32MX250's SRAM, so each pixel is stored
+// as a 4 bit index into a palette of up to 16 colors (8KB total)
+#ifndef LCD_FRAMEBUFFER
+#define LCD_FRAMEBUFFER 0
+#endif
+#define LCD_PALETTE_SIZE 16
+#define LCD_DIRTY_MAX 8 // number of dirty rectangles tracked between flushes
+
 #define	BLACK     0x0000
 #define WHITE     0xFFFF
 #define	BLUE      0x001F
@@ -168,15 +177,54 @@ static const char ASCII[96][5] = {
 static unsigned char pGammaSet[15]= {0x36,0x29,0x12,0x22,0x1C,0x15,0x42,0xB7,0x2F,0x13,0x12,0x0A,0x11,0x0B,0x06};
 static unsigned char nGammaSet[15]= {0x09,0x16,0x2D,0x0D,0x13,0x15,0x40,0x48,0x53,0x0C,0x1D,0x25,0x2E,0x34,0x39};
 
+// run-length encoded image, made from a PNG by tools/png2sprite.py
+// each byte of data is a run: high nibble n, low nibble palette color, n+1 pixels for n < 15,
+// and 16 plus the next byte for n = 15. runs go left to right, top to bottom
+typedef struct {
+    unsigned char width, height;
+    unsigned char colors; // entries in palette, up to 16
+    const unsigned short *palette;
+    const unsigned char *data;
+} LCD_SPRITE;
+
+extern unsigned long LCD_spiBytes; // bytes sent to the LCD, clear it to measure a frame
+extern unsigned long LCD_pixels; // pixels drawn by LCD_fillRect and the lines and circles, clear it to count
+
+// ways of sending pixels, chosen in SPI1_init so they can be compared
+#define LCD_BUS_BYTE 0 // 8 bit spi, CS toggled around every pixel
+#define LCD_BUS_FIFO 1 // 16 bit words through the 8 deep enhanced buffer, CS held for the whole window
+#define LCD_BUS_DMA  2 // like LCD_BUS_FIFO, with fills and flushes sent by DMA
+
+void SPI1_init(unsigned char); // set up spi1 for the LCD with one of the LCD_BUS_ modes
 unsigned char spi_io(unsigned char); // send and rx a byte over spi
 void LCD_command(unsigned char); // send a command to the LCD
 void LCD_data(unsigned char); // send data to the LCD
 void LCD_data16(unsigned short); // send 16 bit data to the LCD
 void LCD_init(void); // send the initializations to the LCD
+void LCD_scrollArea(unsigned short top, unsigned short height); // rows of the LCD memory that scroll
+void LCD_scrollTo(unsigned short line); // memory row shown at the top of the scroll area
 void LCD_drawPixel(unsigned short, unsigned short, unsigned short); // set the x,y pixel to a color
 void LCD_setAddr(unsigned short, unsigned short, unsigned short, unsigned short); // set the memory address you are writing to
 void LCD_clearScreen(unsigned short); // set the color of every pixel
 void LCD_drawString(unsigned short left, unsigned short top, char *text);
 void LCD_drawChar(unsigned short xStart, unsigned short yStart, char symbol);
+void LCD_drawCharColor(unsigned short xStart, unsigned short yStart, char symbol, unsigned short fg, unsigned short bg); // one 6x8 block
+void LCD_drawStringColor(unsigned short left, unsigned short top, const char *text, unsigned short fg, unsigned short bg); // one block per line
+void LCD_drawSprite(unsigned short x, unsigned short y, const LCD_SPRITE *sprite); // one block, top left at x,y
+void LCD_beginWindow(unsigned short, unsigned short, unsigned short, unsigned short); // start a block of pixels, corners inclusive
+void LCD_pushColor(unsigned short); // write the next pixel of the block, left to right then top to bottom
+void LCD_endWindow(void); // finish the block
+void LCD_fillRect(unsigned short x, unsigned short y, unsigned short w, unsigned short h, unsigned short color);
+void LCD_hline(unsigned short x, unsigned short y, unsigned short w, unsigned short color);
+void LCD_vline(unsigned short x, unsigned short y, unsigned short h, unsigned short color);
+void LCD_drawLine(short x0, short y0, short x1, short y1, unsigned short color); // one block per run of pixels in a row or column
+void LCD_drawCircle(short cx, short cy, short r, unsigned short color);
+void LCD_fillCircle(short cx, short cy, short r, unsigned short color);
+void LCD_markDirty(unsigned short, unsigned short, unsigned short, unsigned short); // framebuffer area that needs sending, corners inclusive
+void LCD_flush(void); // send the dirty parts of the framebuffer to the LCD
+void LCD_flushAsync(void (*done)(void)); // start LCD_flush on the DMA and return, done (can be 0) is called from the interrupt
+void LCD_writePixels(const unsigned short *, unsigned short, void (*done)(void)); // DMA up to 32767 pixels into the current window, the buffer must stay valid until done
+int LCD_busy(void); // 1 while a DMA transfer is running
+void LCD_wait(void); // block until the DMA transfer is done
 
 #endif
\ No newline at end of file
@@ -0,0 +1,370 @@
+// on-device benchmarks for the LCD driver and the I2C bus
+// each one runs a few times and converts core timer ticks into a rate
+
+#include <xc.h>
+#include <stdio.h>
+#include "ILI9163C.h"
+#include "bench.h"
+#include "numfmt.h"
+#include "console.h"
+#include "sprites.h"
+#include "i2c_engine.h"
+#include "fusion.h"
+
+static const char *busNames[] = {"byte", "fifo", "dma"};
+
+// full screen fills per second, x100 so two decimals show
+unsigned long bench_fill(int n) {
+    int i;
+    unsigned int start, ticks;
+
+    start = _CP0_GET_COUNT();
+    for (i = 0; i < n; i++) {
+        LCD_clearScreen(i & 1 ? BLUE : BLACK);
+        LCD_flush();
+    }
+    ticks = _CP0_GET_COUNT() - start;
+    return (unsigned long)((unsigned long long)n * CORE_TICKS_PER_SEC * 100 / ticks);
+}
+
+// draw a character a pixel at a time, the way LCD_drawChar used to
+static void bench_pixelChar(unsigned short x, unsigned short y, char c) {
+    int row, column;
+    for (column = 0; column < 5; column++) {
+        for (row = 0; row < 8; row++) {
+            LCD_drawPixel(x + column, y + row, ((ASCII[c - 32][column] >> row) & 1) ? RED : BLACK);
+        }
+    }
+}
+
+// CPU cycles per character drawn pixel by pixel, as separate 6x8 blocks, and as one block per line
+void bench_char(unsigned long cycles[3]) {
+    static const char text[] = "accelX(g): -0.98   ";
+    const int n = sizeof(text) - 1;
+    const int reps = 10;
+    unsigned int start;
+    int i, j;
+
+    start = _CP0_GET_COUNT();
+    for (i = 0; i < reps; i++) {
+        for (j = 0; j < n; j++) {
+            bench_pixelChar(5 + 6*j, 60, text[j]);
+        }
+    }
+    LCD_flush();
+    cycles[0] = (unsigned long)(_CP0_GET_COUNT() - start) * 2 / (reps * n);
+
+    start = _CP0_GET_COUNT();
+    for (i = 0; i < reps; i++) {
+        for (j = 0; j < n; j++) {
+            LCD_drawCharColor(5 + 6*j, 60, text[j], RED, BLACK);
+        }
+    }
+    LCD_flush();
+    cycles[1] = (unsigned long)(_CP0_GET_COUNT() - start) * 2 / (reps * n);
+
+    start = _CP0_GET_COUNT();
+    for (i = 0; i < reps; i++) {
+        LCD_drawStringColor(5, 60, text, RED, BLACK);
+    }
+    LCD_flush();
+    cycles[2] = (unsigned long)(_CP0_GET_COUNT() - start) * 2 / (reps * n);
+}
+
+// CPU cycles to format an IMU reading with two decimals: sprintf("%.2f") and fmt_fixed
+void bench_format(unsigned long cycles[2]) {
+    char buf[FMT_MAX + 8];
+    volatile float f = -0.98f; // volatile so the compiler cannot fold the formatting
+    volatile long v = -98;
+    const int reps = 100;
+    unsigned int start;
+    int i;
+
+    start = _CP0_GET_COUNT();
+    for (i = 0; i < reps; i++) {
+        sprintf(buf, "%.2f", (double)f);
+    }
+    cycles[0] = (unsigned long)(_CP0_GET_COUNT() - start) * 2 / reps;
+
+    start = _CP0_GET_COUNT();
+    for (i = 0; i < reps; i++) {
+        fmt_fixed(buf, v, 2, 0, 0);
+    }
+    cycles[1] = (unsigned long)(_CP0_GET_COUNT() - start) * 2 / reps;
+}
+
+// CPU cycles per scrolled console line, and for redrawing every line of the console instead
+void bench_console(unsigned long cycles[2]) {
+    const int reps = 32;
+    char text[CONSOLE_COLS+1];
+    unsigned int start;
+    int i, row;
+
+    console_init(0, GREEN, BLACK);
+    start = _CP0_GET_COUNT();
+    for (i = 0; i < reps; i++) {
+        console_printf("cmd %d: pwm %+.2f\n", i, (long)i*25 - 400);
+    }
+    LCD_flush();
+    LCD_wait();
+    cycles[0] = (unsigned long)(_CP0_GET_COUNT() - start) * 2 / reps;
+
+    // a console without the hardware scroll moves every line up by one
+    LCD_scrollArea(0, _GRAMHEIGH);
+    LCD_scrollTo(0);
+    start = _CP0_GET_COUNT();
+    for (i = 0; i < reps; i++) {
+        for (row = 0; row < _GRAMHEIGH/CONSOLE_ROW; row++) {
+            sprintf(text, "cmd %-4d: pwm %+6.2f", i + row, (double)((i + row)*25 - 400) / 100);
+            LCD_drawStringColor(0, row*CONSOLE_ROW, text, GREEN, BLACK);
+        }
+    }
+    LCD_flush();
+    LCD_wait();
+    cycles[1] = (unsigned long)(_CP0_GET_COUNT() - start) * 2 / reps;
+}
+
+// CPU cycles to draw the 24x24 IMU sprite: decoded into one block, and decoded pixel by pixel
+void bench_sprite(unsigned long cycles[2]) {
+    const LCD_SPRITE *s = &sprite_imu;
+    const int reps = 20;
+    unsigned int start;
+    unsigned short x, y, run;
+    const unsigned char *p;
+    int i;
+
+    LCD_clearScreen(BLACK);
+    start = _CP0_GET_COUNT();
+    for (i = 0; i < reps; i++) {
+        LCD_drawSprite(50, 50, s);
+    }
+    LCD_flush();
+    LCD_wait();
+    cycles[0] = (unsigned long)(_CP0_GET_COUNT() - start) * 2 / reps;
+
+    start = _CP0_GET_COUNT();
+    for (i = 0; i < reps; i++) {
+        p = s->data;
+        x = 0;
+        y = 0;
+        while (y < s->height) {
+            run = (*p >> 4) + 1;
+            if (run == 16) {
+                run += p[1];
+            }
+            for (; run != 0; run--) {
+                LCD_drawPixel(50 + x, 50 + y, s->palette[*p & 0x0F]);
+                if (++x == s->width) {
+                    x = 0;
+                    y++;
+                }
+            }
+            p += (*p >> 4) == 15 ? 2 : 1;
+        }
+    }
+    LCD_flush();
+    LCD_wait();
+    cycles[1] = (unsigned long)(_CP0_GET_COUNT() - start) * 2 / reps;
+}
+
+static const char *primNames[BENCH_PRIMS] = {"pixel", "fillRect", "hline", "vline", "line", "circle", "fillCirc"};
+
+// CPU cycles per fusion_update, on a reading of a board tilted and turning slowly
+unsigned long bench_fusion(void) {
+    FUSION f;
+    short gyro[3] = {120, -45, 30}, accel[3] = {2100, -3900, 15800};
+    const int reps = 200;
+    unsigned int start;
+    int i;
+
+    fusion_init(&f, FUSION_GYRO_K(8.75, 1660), FUSION_KP(2.0, 1660), FUSION_KI(0.01, 1660));
+    fusion_update(&f, gyro, accel); // the first one only sets the starting orientation
+    start = _CP0_GET_COUNT();
+    for (i = 0; i < reps; i++) {
+        fusion_update(&f, gyro, accel);
+    }
+    return (unsigned long)(_CP0_GET_COUNT() - start) * 2 / reps;
+}
+
+// pixels per second for each primitive, counted with LCD_pixels
+void bench_primitives(unsigned long pps[BENCH_PRIMS]) {
+    const int reps = 20;
+    unsigned int start, ticks;
+    unsigned long pixels;
+    int prim, i;
+
+    for (prim = 0; prim < BENCH_PRIMS; prim++) {
+        LCD_clearScreen(BLACK);
+        LCD_flush();
+        LCD_wait();
+        LCD_pixels = 0;
+        start = _CP0_GET_COUNT();
+        for (i = 0; i < reps; i++) {
+            unsigned short color = i & 1 ? YELLOW : CYAN;
+            switch (prim) {
+                case 0: // a 10x10 square one pixel at a time, for comparison
+                    {
+                        unsigned short x, y;
+                        for (y = 0; y < 10; y++) {
+                            for (x = 0; x < 10; x++) {
+                                LCD_drawPixel(40 + x, 40 + y, color);
+                            }
+                        }
+                        LCD_pixels += 100;
+                    }
+                    break;
+                case 1:
+                    LCD_fillRect(20, 20, 80, 80, color);
+                    break;
+                case 2:
+                    LCD_hline(4, 64, 120, color);
+                    break;
+                case 3:
+                    LCD_vline(64, 4, 120, color);
+                    break;
+                case 4:
+                    LCD_drawLine(0, 10, 127, 117, color);
+                    break;
+                case 5:
+                    LCD_drawCircle(64, 64, 50, color);
+                    break;
+                case 6:
+                    LCD_fillCircle(64, 64, 40, color);
+                    break;
+            }
+        }
+        LCD_flush();
+        LCD_wait();
+        ticks = _CP0_GET_COUNT() - start;
+        pixels = LCD_pixels;
+        pps[prim] = (unsigned long)((unsigned long long)pixels * CORE_TICKS_PER_SEC / ticks);
+    }
+}
+
+// time the primitives and show pixels per second for each
+void bench_runPrimitives(void) {
+    char line[32];
+    unsigned long pps[BENCH_PRIMS];
+    int prim;
+
+    bench_primitives(pps);
+    LCD_clearScreen(BLACK);
+    LCD_drawString(5, 2, "pixels/s");
+    for (prim = 0; prim < BENCH_PRIMS; prim++) {
+        sprintf(line, "%-9s %lu", primNames[prim], pps[prim]);
+        LCD_drawString(5, 16 + 10*prim, line);
+    }
+    LCD_flush();
+}
+
+static const unsigned long i2cSpeeds[BENCH_I2C_SPEEDS] = {I2C_STANDARD, I2C_FAST, I2C_FAST_PLUS};
+
+// microseconds for a len byte burst read at each of the I2C speeds, 0 if the slave did not answer
+void bench_i2c(unsigned long pbclk, unsigned char address, unsigned char reg, unsigned char len, unsigned long us[BENCH_I2C_SPEEDS], unsigned long actual[BENCH_I2C_SPEEDS]) {
+    const int reps = 50;
+    unsigned char buf[32];
+    I2C_TXN txn;
+    unsigned int start;
+    int speed, i;
+
+    if (len > sizeof(buf)) {
+        len = sizeof(buf);
+    }
+    for (speed = 0; speed < BENCH_I2C_SPEEDS; speed++) {
+        actual[speed] = i2c_engine_setSpeed(pbclk, i2cSpeeds[speed]);
+        us[speed] = 0;
+        start = _CP0_GET_COUNT();
+        for (i = 0; i < reps; i++) {
+            i2c_engine_read(&txn, address, reg, buf, len, 0);
+            if (i2c_engine_wait(&txn) != I2C_DONE) {
+                break;
+            }
+        }
+        if (i == reps) {
+            us[speed] = (_CP0_GET_COUNT() - start) / (CORE_TICKS_PER_SEC / 1000000) / reps;
+        }
+    }
+}
+
+// time a len byte burst read at each I2C speed, then go back to speed
+void bench_runI2C(unsigned long pbclk, unsigned long speed, unsigned char address, unsigned char reg, unsigned char len) {
+    char line[32];
+    unsigned long us[BENCH_I2C_SPEEDS], actual[BENCH_I2C_SPEEDS];
+    int i;
+
+    bench_i2c(pbclk, address, reg, len, us, actual);
+    i2c_engine_setSpeed(pbclk, speed);
+
+    LCD_clearScreen(BLACK);
+    sprintf(line, "%d byte read", len);
+    LCD_drawString(5, 2, line);
+    for (i = 0; i < BENCH_I2C_SPEEDS; i++) {
+        // 9 clocks per byte: address, reg, address again and the data
+        sprintf(line, "%lu Hz", actual[i]);
+        LCD_drawString(5, 16 + 30*i, line);
+        if (us[i]) {
+            sprintf(line, " %lu us (bus %lu)", us[i], (len + 3) * 9 * 1000000UL / actual[i]);
+        } else {
+            sprintf(line, " no answer");
+        }
+        LCD_drawString(5, 26 + 30*i, line);
+    }
+    LCD_flush();
+}
+
+// run every benchmark on each LCD_BUS_ mode, then go back to busMode
+void bench_run(unsigned char busMode) {
+    char line[32];
+    unsigned long fill[3];
+    unsigned long bytes = 0;
+    unsigned long cycles[3];
+    unsigned long fmtCycles[2];
+    unsigned long conCycles[2];
+    unsigned long spriteCycles[2];
+    unsigned long fusionCycles;
+    unsigned char mode;
+
+    for (mode = LCD_BUS_BYTE; mode <= LCD_BUS_DMA; mode++) {
+        SPI1_init(mode);
+        LCD_spiBytes = 0;
+        fill[mode] = bench_fill(mode == LCD_BUS_BYTE ? 4 : 20);
+        if (mode == LCD_BUS_DMA) {
+            bytes = LCD_spiBytes / 20;
+        }
+    }
+    SPI1_init(busMode);
+    bench_char(cycles);
+    bench_format(fmtCycles);
+    bench_console(conCycles);
+    bench_sprite(spriteCycles);
+    fusionCycles = bench_fusion();
+
+    LCD_clearScreen(BLACK);
+    for (mode = LCD_BUS_BYTE; mode <= LCD_BUS_DMA; mode++) {
+        sprintf(line, "%s fill/s: %lu.%02lu", busNames[mode], fill[mode] / 100, fill[mode] % 100);
+        LCD_drawString(5, 2 + 9*mode, line);
+    }
+    sprintf(line, "bytes/fill: %lu", bytes);
+    LCD_drawString(5, 29, line);
+    sprintf(line, "cyc/char px: %lu", cycles[0]);
+    LCD_drawString(5, 38, line);
+    sprintf(line, "cyc/char blk: %lu", cycles[1]);
+    LCD_drawString(5, 47, line);
+    sprintf(line, "cyc/char str: %lu", cycles[2]);
+    LCD_drawString(5, 56, line);
+    sprintf(line, "cyc sprintf: %lu", fmtCycles[0]);
+    LCD_drawString(5, 65, line);
+    sprintf(line, "cyc fmt_fixed: %lu", fmtCycles[1]);
+    LCD_drawString(5, 74, line);
+    sprintf(line, "scroll/line: %lu", conCycles[0]);
+    LCD_drawString(5, 83, line);
+    sprintf(line, "redraw/line: %lu", conCycles[1]);
+    LCD_drawString(5, 92, line);
+    sprintf(line, "sprite rle: %lu", spriteCycles[0]);
+    LCD_drawString(5, 101, line);
+    sprintf(line, "sprite px: %lu", spriteCycles[1]);
+    LCD_drawString(5, 110, line);
+    sprintf(line, "cyc fusion: %lu", fusionCycles);
+    LCD_drawString(5, 119, line);
+    LCD_flush();
+}
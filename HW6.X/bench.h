@@ -0,0 +1,22 @@
+// on-device benchmarks for the LCD driver, the I2C bus and the sensor fusion, timed with the core timer
+
+#ifndef BENCH_H__
+#define BENCH_H__
+
+#define CORE_TICKS_PER_SEC 24000000 // core timer runs at half the 48MHz CPU clock
+#define BENCH_I2C_SPEEDS 3 // 100 kHz, 400 kHz, 1 MHz
+#define BENCH_PRIMS 7 // drawPixel, fillRect, hline, vline, drawLine, drawCircle, fillCircle
+
+unsigned long bench_fill(int n); // full screen fills per second, x100
+void bench_char(unsigned long cycles[3]); // CPU cycles per character: pixel by pixel, per character block, per line block
+void bench_format(unsigned long cycles[2]); // CPU cycles per "%.2f" reading: sprintf, fmt_fixed
+void bench_console(unsigned long cycles[2]); // CPU cycles per console line: hardware scroll, redrawing every line
+void bench_sprite(unsigned long cycles[2]); // CPU cycles per 24x24 sprite: run decoded block, pixel by pixel
+unsigned long bench_fusion(void); // CPU cycles per fusion_update
+void bench_primitives(unsigned long pps[BENCH_PRIMS]); // pixels per second for each drawing primitive
+void bench_i2c(unsigned long pbclk, unsigned char address, unsigned char reg, unsigned char len, unsigned long us[BENCH_I2C_SPEEDS], unsigned long actual[BENCH_I2C_SPEEDS]); // us per burst read at each speed, 0 for no answer
+void bench_run(unsigned char busMode); // run the benchmarks on each LCD_BUS_ mode, show the results and go back to busMode
+void bench_runPrimitives(void); // show pixels per second for each drawing primitive
+void bench_runI2C(unsigned long pbclk, unsigned long speed, unsigned char address, unsigned char reg, unsigned char len); // show burst read times, then go back to speed
+
+#endif
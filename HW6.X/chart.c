@@ -0,0 +1,126 @@
+// strip chart on the ILI9163C
+// the chart is a ring of columns. a sample goes in the column after the last one and wraps
+// to the left edge at the right, so the oldest column is the one that gets overwritten and
+// nothing else moves. each column is sent as one block, with every trace drawn as a
+// vertical run from its last row to its new one so fast signals stay joined up
+
+#include "ILI9163C.h"
+#include "chart.h"
+
+void chart_init(CHART *c, unsigned short x, unsigned short y, unsigned short w, unsigned short h, short min, short max, unsigned short bg, unsigned short grid) {
+    if (x >= _GRAMWIDTH) {
+        x = _GRAMWIDTH - 1;
+    }
+    if (y >= _GRAMHEIGH) {
+        y = _GRAMHEIGH - 1;
+    }
+    c->x = x;
+    c->y = y;
+    c->w = x + w > _GRAMWIDTH ? _GRAMWIDTH - x : w;
+    c->h = y + h > _GRAMHEIGH ? _GRAMHEIGH - y : h;
+    if (c->w == 0) {
+        c->w = 1;
+    }
+    if (c->h < 2) {
+        c->h = 2;
+    }
+    c->bg = bg;
+    c->grid = grid;
+    c->traces = 0;
+    c->min = min;
+    c->max = max > min ? max : min + 1;
+    c->decimate = 1;
+    c->columns = 0;
+    chart_clear(c);
+}
+
+void chart_trace(CHART *c, unsigned char trace, unsigned short color) {
+    if (trace >= CHART_TRACES) {
+        return;
+    }
+    c->color[trace] = color;
+    if (trace >= c->traces) {
+        c->traces = trace + 1;
+    }
+}
+
+void chart_setDecimation(CHART *c, unsigned char n) {
+    c->decimate = n ? n : 1;
+    c->count = 0;
+}
+
+void chart_clear(CHART *c) {
+    int i;
+
+    LCD_fillRect(c->x, c->y, c->w, c->h, c->bg);
+    c->head = 0;
+    c->count = 0;
+    for (i = 0; i < CHART_TRACES; i++) {
+        c->sum[i] = 0;
+        c->last[i] = -1;
+    }
+}
+
+// row of the chart for a value, 0 at the top
+static short chart_row(CHART *c, long v) {
+    if (v <= c->min) {
+        return c->h - 1;
+    }
+    if (v >= c->max) {
+        return 0;
+    }
+    return (short)((c->max - v) * (c->h - 1) / ((long)c->max - c->min));
+}
+
+int chart_add(CHART *c, const short *values) {
+    short lo[CHART_TRACES], hi[CHART_TRACES], row, zero;
+    unsigned short color;
+    int i;
+
+    for (i = 0; i < c->traces; i++) {
+        c->sum[i] += values[i];
+    }
+    if (++c->count < c->decimate) {
+        return 0;
+    }
+
+    // each trace covers the rows between where it was and where it is now
+    for (i = 0; i < c->traces; i++) {
+        row = chart_row(c, c->sum[i] / c->count);
+        lo[i] = row;
+        hi[i] = row;
+        if (c->last[i] >= 0) {
+            if (c->last[i] < row) {
+                lo[i] = c->last[i];
+            } else {
+                hi[i] = c->last[i];
+            }
+        }
+        c->last[i] = row;
+        c->sum[i] = 0;
+    }
+    c->count = 0;
+    zero = c->min < 0 && c->max > 0 ? chart_row(c, 0) : -1;
+
+    LCD_beginWindow(c->x + c->head, c->y, c->x + c->head, c->y + c->h - 1);
+    for (row = 0; row < c->h; row++) {
+        color = row == zero ? c->grid : c->bg;
+        for (i = 0; i < c->traces; i++) { // later traces are drawn over earlier ones
+            if (row >= lo[i] && row <= hi[i]) {
+                color = c->color[i];
+            }
+        }
+        LCD_pushColor(color);
+    }
+    LCD_endWindow();
+
+    // the first column after wrapping has nothing to join to on its left
+    if (++c->head == c->w) {
+        c->head = 0;
+        for (i = 0; i < c->traces; i++) {
+            c->last[i] = -1;
+        }
+    }
+    c->columns++;
+    return 1;
+}
@@ -0,0 +1,30 @@
+// strip chart of up to CHART_TRACES signals on the ILI9163C
+// each plotted sample is one column, written over the oldest column like a sweeping scope,
+// so a new sample costs one column of pixels however wide the chart is
+
+#ifndef CHART_H__
+#define CHART_H__
+
+#define CHART_TRACES 4
+
+typedef struct {
+    unsigned short x, y, w, h; // area on the LCD
+    unsigned short bg, grid; // background and zero line colors
+    unsigned char traces;
+    unsigned short color[CHART_TRACES];
+    short min, max; // values at the bottom and top of the chart
+    unsigned char decimate; // samples averaged into each column
+    unsigned char count; // samples in sum so far
+    long sum[CHART_TRACES];
+    unsigned short head; // column the next sample goes in
+    short last[CHART_TRACES]; // row of each trace in the last column, -1 when there is none
+    unsigned long columns; // columns drawn, read it twice to get the plot rate
+} CHART;
+
+void chart_init(CHART *c, unsigned short x, unsigned short y, unsigned short w, unsigned short h, short min, short max, unsigned short bg, unsigned short grid);
+void chart_trace(CHART *c, unsigned char trace, unsigned short color); // traces are numbered from 0 and added in order
+void chart_setDecimation(CHART *c, unsigned char n); // average n samples per column, 1 plots every sample
+int chart_add(CHART *c, const short *values); // one sample of every trace, returns 1 if a column was drawn
+void chart_clear(CHART *c); // blank the chart and start again from the left
+
+#endif
@@ -0,0 +1,239 @@
+// scrolling text console on the ILI9163C
+// the console rows are an LCD scroll area, and the text row shown at the top of it is
+// moved with LCD_scrollTo, so when the console is full the oldest row becomes the newest
+// one without redrawing the others. a finished line is drawn once, padded to the full
+// width to cover what was in that row, so each new line costs one row of pixels
+
+#include <stdarg.h>
+#include "ILI9163C.h"
+#include "console.h"
+#include "numfmt.h"
+
+static unsigned short conTop; // first LCD row of the console
+static unsigned char conRows; // lines in the console
+static unsigned short conFg, conBg;
+static unsigned char conScroll; // line of LCD memory shown at the top of the console
+static unsigned char conRow; // line on the screen that has the cursor
+static unsigned char conCol;
+static unsigned char conNewline; // a '\n' was printed, move down before the next character
+static char conLine[CONSOLE_COLS+1]; // the cursor line, padded with spaces
+static unsigned char conDrawn; // first character of conLine that has not been drawn
+static unsigned char conClean; // from here on the cursor row is blank on the LCD
+
+// LCD memory row of a line on the screen
+static unsigned short console_y(unsigned char row) {
+    return conTop + ((conScroll + row) % conRows) * CONSOLE_ROW;
+}
+
+// send the characters of the cursor line that changed, and spaces over anything left in the row
+static void console_draw(void) {
+    unsigned char end = conClean > conCol ? conClean : conCol;
+    char save;
+
+    if (conDrawn < end) {
+        save = conLine[end];
+        conLine[end] = 0;
+        LCD_drawStringColor(6*conDrawn, console_y(conRow), &conLine[conDrawn], conFg, conBg);
+        conLine[end] = save;
+    }
+    conDrawn = conCol;
+    conClean = conCol;
+}
+
+// finish the cursor line and start the next one, scrolling when the console is full
+static void console_advance(void) {
+    int i;
+
+    console_draw();
+    if (conRow + 1 < conRows) {
+        conRow++;
+    } else {
+        conScroll = (conScroll + 1) % conRows;
+        LCD_scrollTo(conTop + conScroll*CONSOLE_ROW);
+    }
+    for (i = 0; i < CONSOLE_COLS; i++) {
+        conLine[i] = ' ';
+    }
+    conCol = 0;
+    conDrawn = 0;
+    conClean = CONSOLE_COLS; // the row still shows the line that scrolled off
+}
+
+static void console_putc(char c) {
+    if (c == '\n') {
+        if (conNewline) {
+            console_advance(); // a blank line
+        }
+        conNewline = 1;
+        return;
+    }
+    if (c < ' ') {
+        return;
+    }
+    if (conNewline || conCol == CONSOLE_COLS) {
+        console_advance();
+        conNewline = 0;
+    }
+    conLine[conCol] = c;
+    if (conCol < conDrawn) {
+        conDrawn = conCol;
+    }
+    conCol++;
+}
+
+void console_init(unsigned short top, unsigned short fg, unsigned short bg) {
+    if (top > _GRAMHEIGH - CONSOLE_ROW) {
+        top = _GRAMHEIGH - CONSOLE_ROW;
+    }
+    top += (_GRAMHEIGH - top) % CONSOLE_ROW;
+    conTop = top;
+    conRows = (_GRAMHEIGH - top) / CONSOLE_ROW;
+    conFg = fg;
+    conBg = bg;
+    LCD_scrollArea(conTop, conRows*CONSOLE_ROW);
+    console_clear();
+}
+
+void console_clear(void) {
+    int i;
+
+    LCD_fillRect(0, conTop, _GRAMWIDTH, conRows*CONSOLE_ROW, conBg);
+    conScroll = 0;
+    LCD_scrollTo(conTop);
+    for (i = 0; i < CONSOLE_COLS; i++) {
+        conLine[i] = ' ';
+    }
+    conLine[CONSOLE_COLS] = 0;
+    conRow = 0;
+    conCol = 0;
+    conNewline = 0;
+    conDrawn = 0;
+    conClean = 0;
+}
+
+void console_print(const char *text) {
+    while (*text != 0) {
+        console_putc(*text++);
+    }
+    console_draw();
+}
+
+// text padded to width, with zeros in front for FMT_ZERO
+static void console_field(const char *text, int len, int width, unsigned char flags) {
+    int pad = width > len ? width - len : 0;
+
+    if (!(flags & FMT_LEFT)) {
+        for (; pad > 0; pad--) {
+            console_putc((flags & FMT_ZERO) ? '0' : ' ');
+        }
+    }
+    while (len-- > 0) {
+        console_putc(*text++);
+    }
+    for (; pad > 0; pad--) {
+        console_putc(' ');
+    }
+}
+
+void console_printf(const char *format, ...) {
+    char buf[FMT_MAX > CONSOLE_COLS+1 ? FMT_MAX : CONSOLE_COLS+1];
+    va_list args;
+    unsigned char flags, width, decimals, isLong;
+    unsigned long u;
+    const char *s;
+    int n;
+
+    va_start(args, format);
+    while (*format != 0) {
+        if (*format != '%') {
+            console_putc(*format++);
+            continue;
+        }
+        format++;
+
+        flags = 0;
+        for (;; format++) {
+            if (*format == '-') {
+                flags |= FMT_LEFT;
+            } else if (*format == '+') {
+                flags |= FMT_PLUS;
+            } else if (*format == '0') {
+                flags |= FMT_ZERO;
+            } else {
+                break;
+            }
+        }
+        width = 0;
+        while (*format >= '0' && *format <= '9') {
+            if (width < CONSOLE_COLS) {
+                width = width*10 + (*format - '0');
+            }
+            format++;
+        }
+        if (width > CONSOLE_COLS) {
+            width = CONSOLE_COLS;
+        }
+        decimals = 0;
+        if (*format == '.') {
+            format++;
+            while (*format >= '0' && *format <= '9') {
+                decimals = decimals*10 + (*format++ - '0');
+            }
+        }
+        isLong = 0;
+        if (*format == 'l') {
+            isLong = 1;
+            format++;
+        }
+
+        switch (*format) {
+            case 'd':
+                n = fmt_int(buf, isLong ? va_arg(args, long) : va_arg(args, int), width, flags);
+                console_field(buf, n, 0, 0);
+                break;
+            case 'u':
+                u = isLong ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+                n = fmt_uint(buf, u, width, flags & ~FMT_PLUS);
+                console_field(buf, n, 0, 0);
+                break;
+            case 'f':
+                n = fmt_fixed(buf, va_arg(args, long), decimals, width, flags);
+                console_field(buf, n, 0, 0);
+                break;
+            case 'x':
+                u = isLong ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+                n = sizeof(buf);
+                do {
+                    buf[--n] = "0123456789abcdef"[u & 0xF];
+                    u >>= 4;
+                } while (u != 0);
+                console_field(&buf[n], sizeof(buf) - n, width, flags);
+                break;
+            case 'c':
+                buf[0] = (char)va_arg(args, int);
+                console_field(buf, 1, width, flags & FMT_LEFT);
+                break;
+            case 's':
+                s = va_arg(args, const char *);
+                for (n = 0; s[n] != 0; n++) {
+                    ;
+                }
+                console_field(s, n, width, flags & FMT_LEFT);
+                break;
+            case '%':
+                console_putc('%');
+                break;
+            default: // unknown, print it as it was
+                console_putc('%');
+                if (*format == 0) {
+                    format--;
+                } else {
+                    console_putc(*format);
+                }
+                break;
+        }
+        format++;
+    }
+    va_end(args);
+    console_draw();
+}
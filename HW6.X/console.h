@@ -0,0 +1,20 @@
+// scrolling text console on the ILI9163C, using the LCD's vertical scroll
+// a new line is drawn into the row that scrolled off the top, so it costs one row of pixels
+
+#ifndef CONSOLE_H__
+#define CONSOLE_H__
+
+#define CONSOLE_COLS 21 // characters per line, 6 pixels each
+#define CONSOLE_ROW 8 // pixels per line
+
+// use the rows from top to the bottom of the LCD, the rows above top are left alone
+// the height below top must be a multiple of CONSOLE_ROW, top is rounded to make it one
+void console_init(unsigned short top, unsigned short fg, unsigned short bg);
+void console_clear(void); // blank the console and put the cursor at the top left
+void console_print(const char *text); // '\n' starts a new line, long lines wrap
+
+// printf without the floating point: %c %s %d %u %x %%, l for long, flags - + 0 and a width
+// %.Nf prints a long that is already scaled by 10^N, e.g. console_printf("%.2f", 98) is 0.98
+void console_printf(const char *format, ...);
+
+#endif
@@ -3,6 +3,15 @@
 #include <stdio.h>
 #include <math.h> 
 #include "ILI9163C.h"
+#include "bench.h"
+#include "textfield.h"
+#include "chart.h"
+#include "i2c_engine.h"
+#include "lsm6ds33.h"
+#include "fusion.h"
+#include "calib.h"
+#include "i2c_dev.h"
+#include "i2c_sched.h"
 
 // DEVCFG0
 #pragma config DEBUG = OFF // no debugging
@@ -39,75 +48,159 @@
 #pragma config FUSBIDIO = ON // USB pins controlled by USB module
 #pragma config FVBUSONIO = ON // USB BUSON controlled by USB module
 
+#define RUN_BENCHMARKS 0 // 1 to show the LCD benchmarks at startup
+#define SHOW_CHART 0 // 1 for a strip chart of the accelerometer instead of the numbers
+#define CHART_DECIMATE 4 // accelerometer samples averaged into each chart column
+#define FIFO_WATERMARK 8 // samples in the IMU FIFO before the chart drains it
+
 #define IMU_ADDRESS 0b1101011
 #define OUT_TEMP_L 0x20
 
+#define PBCLK 48000000 // FPBDIV = DIV_1
+#define I2C_SPEED I2C_FAST // the LSM6DS33 goes up to 400 kHz
+
 //CTRL1,CTRL2,CTRL3 initialize values//
 #define CTRL1_XL 0b10000001
 #define CTRL2_G  0b10000000
 #define CTRL3_C  0b00000100
+#define IMU_ODR 1660 // Hz, CTRL1_XL and CTRL2_G
+#define GYRO_MDPS 8.75 // mdps per LSB at 245 dps, CTRL2_G
 
 //I2C functions//
 void initI2C2(void){
     ANSELBbits.ANSB2 = 0;
     ANSELBbits.ANSB3 = 0;
-    //some number for 100kHz; // I2CBRG = [1/(2*Fsck) - PGD]*Pblck - 2
-    I2C2BRG = 233;           // PGD = 104ns, Fsck = 100kHz, Pblck = 48MHz.
-    I2C2CONbits.ON = 1;      // turn on the I2C2 module
+    i2c_engine_setSpeed(PBCLK, I2C_SPEED); // works out I2C2BRG and turns on the I2C2 module
 }
 
-void i2c_master_start(void) {
-    I2C2CONbits.SEN = 1;            // send the start bit
-    while(I2C2CONbits.SEN) { ; }    // wait for the start bit to be sent
-}
+//function initializations//
+unsigned char readIMU(char reg);
+void init_IMU(void);
+void LCD_drawString(unsigned short x, unsigned short y, char *array);
 
-void i2c_master_restart(void) {
-    I2C2CONbits.RSEN = 1;           // send a restart
-    while(I2C2CONbits.RSEN) { ; }   // wait for the restart to clear
-}
+//variable initialization//
+    signed short scaleA = 16383;
+    signed short scaleG = 134;
+    signed short gyroX,gyroY,gyroZ,accelX,accelY,accelZ,temp;
+    LSM6_READING imu; // newest reading from the data ready interrupt
+    FUSION fusion; // roll and pitch from the gyro and accel
+    short roll, pitch; // hundredths of a degree
 
-void i2c_master_send(unsigned char byte) { // send a byte to slave
-  I2C2TRN = byte;                   // if an address, bit 0 = 0 for write, 1 for read
-  while(I2C2STATbits.TRSTAT) { ; }  // wait for the transmission to finish
-  if(I2C2STATbits.ACKSTAT) {        // if this is high, slave has not acknowledged
-    // ("I2C2 Master: failed to receive ACK\r\n");
-  }
-}
+//LCD layout, the labels are drawn once and the values are fields//
+    static char *labels[7] = {"accelX(g):", "accelY(g):", "accelZ(g):",
+                              "gyroX(dps):", "gyroY(dps):", "gyroZ(dps):", "TEMP:"};
+    static const unsigned short rows[7] = {12, 27, 42, 57, 72, 87, 102};
+    FIELD values[7];
+    FIELD glyphs; // characters redrawn in the last frame
+    FIELD busLoad; // percent of the I2C2 bus the IMU used in the last second
+    static I2C_SCHED_DEV imuBus = {IMU_ADDRESS, 1, 0}; // counts the IMU's bus time, its reads go to the engine directly
+    FIELD angles[2]; // roll and pitch, in degrees
+    CALIB calib; // corrections for every reading
+    CALIB_RUN calibRun; // captures for calibrate
+
+// busy wait. timed from a stamp rather than by resetting the core timer, which the I2C2 engine
+// times its transactions with
+void wait_seconds(unsigned int seconds) {
+    unsigned int start = _CP0_GET_COUNT();
 
-unsigned char i2c_master_recv(void) { // receive a byte from the slave
-    I2C2CONbits.RCEN = 1;             // start receiving data
-    while(!I2C2STATbits.RBF) { ; }    // wait to receive the data
-    return I2C2RCV;                   // read and return the data
+    while (_CP0_GET_COUNT() - start < seconds*CORE_TICKS_PER_SEC) {;}
 }
 
-void i2c_master_ack(int val) {        // sends ACK = 0 (slave should send another byte)
-                                      // or NACK = 1 (no more bytes requested from slave)
-    I2C2CONbits.ACKDT = val;          // store ACK/NACK in ACKDT
-    I2C2CONbits.ACKEN = 1;            // send ACKDT
-    while(I2C2CONbits.ACKEN) { ; }    // wait for ACK/NACK to be sent
+// the labels, with empty fields for the readings
+void draw_readings(void) {
+    int i;
+
+    LCD_clearScreen(BLACK);
+    for (i = 0; i < 7; i++) {
+        LCD_drawString(5, rows[i], labels[i]);
+        field_init(&values[i], 77, rows[i], 8, RED, BLACK);
+    }
+    LCD_drawString(5, 117, "glyphs:");
+    field_init(&glyphs, 47, 117, 4, RED, BLACK);
+    LCD_drawString(71, 117, "bus%:");
+    field_init(&busLoad, 101, 117, 4, RED, BLACK);
+    LCD_drawString(5, 2, "r:");
+    field_init(&angles[0], 17, 2, 6, RED, BLACK);
+    LCD_drawString(65, 2, "p:");
+    field_init(&angles[1], 77, 2, 6, RED, BLACK);
+    LCD_flush();
 }
 
-void i2c_master_stop(void) {          // send a STOP:
-  I2C2CONbits.PEN = 1;                // comm is complete and master relinquishes bus
-  while(I2C2CONbits.PEN) { ; }        // wait for STOP to complete
+// capture the biases with the board still and keep them in flash. each capture with another
+// side of the board down adds that axis' accel scale. starts once the button is let go
+void calibrate(void) {
+    int result = 0;
+
+    LCD_clearScreen(BLACK);
+    LCD_drawString(5, 50, "calibrating,");
+    LCD_drawString(5, 60, "hold still");
+    LCD_flush();
+    while (!PORTBbits.RB4) {;}
+
+    calib_restart(&calibRun);
+    while (result != 1) {
+        while (!lsm6_drdyRead(&imu)) {
+            i2c_engine_tasks(); // gives up on a read the bus has hung on
+        }
+        result = calib_add(&calibRun, &calib, imu.gyro, imu.accel);
+    }
+    if (!calib_save(&calib)) {
+        LCD_drawString(5, 70, "flash write failed");
+        LCD_flush();
+        wait_seconds(2);
+    }
 }
 
-//function initializations//
-unsigned char readIMU(char reg);
-void init_IMU(void);
-void I2C_read_multiple(char address, char Register, unsigned char * data, char length);
-void LCD_drawString(unsigned short x, unsigned short y, char *array);
+// strip chart of the accelerometer, streamed through the sensor's FIFO at its full 1.66 kHz,
+// with the samples and chart columns per second underneath. never returns
+void plot_accel(void) {
+    CHART chart;
+    FIELD readRate, plotRate;
+    LSM6_SAMPLE batch[LSM6_BATCH];
+    unsigned long reads = 0, lastColumns = 0;
+    unsigned int second;
+    int i, n;
 
-//variable initialization//
-    unsigned char output[14];
-    signed short scaleA = 16383;
-    signed short scaleG = 134;
-    signed short gyroX,gyroY,gyroZ,accelX,accelY,accelZ,temp;
-    float accelXf,accelYf,accelZf,gyroXf,gyroYf,gyroZf;
-    char array[100];
+    LCD_clearScreen(BLACK);
+    chart_init(&chart, 0, 0, _GRAMWIDTH, 112, -2*scaleA, 2*scaleA, BLACK, BLUE); // +-2 g
+    chart_trace(&chart, 0, RED);
+    chart_trace(&chart, 1, GREEN);
+    chart_trace(&chart, 2, YELLOW);
+    chart_setDecimation(&chart, CHART_DECIMATE);
+    LCD_drawString(0, 117, "in:");
+    field_init(&readRate, 18, 117, 5, RED, BLACK);
+    LCD_drawString(54, 117, "plot:");
+    field_init(&plotRate, 84, 117, 5, RED, BLACK);
+    LCD_flush();
 
+    lsm6_fifoInit(LSM6_ODR_1660, 1, 0, 3*FIFO_WATERMARK); // accelerometer only
+    second = _CP0_GET_COUNT();
+    while (1) {
+        // the watermark starts each drain from INT1, and the next one runs in the background
+        // while this batch is plotted
+        i2c_engine_tasks(); // gives up on a read the bus has hung on
+        n = lsm6_fifoSamples(batch, LSM6_BATCH);
+        for (i = 0; i < n; i++) {
+            if (chart_add(&chart, batch[i].accel)) {
+                LCD_flush(); // send the new column when drawing into the framebuffer
+            }
+        }
+        reads += n;
+
+        if (_CP0_GET_COUNT() - second >= CORE_TICKS_PER_SEC) {
+            second += CORE_TICKS_PER_SEC;
+            field_setInt(&readRate, reads);
+            field_setInt(&plotRate, chart.columns - lastColumns);
+            reads = 0;
+            lastColumns = chart.columns;
+            LCD_flush();
+        }
+    }
+}
 
 int main() {
+    unsigned int second;
+
     __builtin_disable_interrupts();
 
     // set the CP0 CONFIG register to indicate that kseg0 is cacheable (0x3)
@@ -128,112 +221,102 @@ int main() {
     LATAbits.LATA4 = 0;
     
     initI2C2();
-    SPI1_init();
+    SPI1_init(LCD_BUS_DMA);
     LCD_init();
-    init_IMU();
-    LCD_clearScreen(BLACK);
-    
-    __builtin_enable_interrupts();
+    i2c_engine_init(0); // IMU reads run from the I2C2 interrupt from here on
+    i2c_sched_init(); // takes the engine's accounting
+    i2c_sched_addDevice(&imuBus);
     
+    __builtin_enable_interrupts(); // the LCD DMA, I2C2 and IMU data ready interrupts are needed from here on
+    init_IMU();
+
+    if (RUN_BENCHMARKS) {
+        bench_run(LCD_BUS_DMA);
+        wait_seconds(5); // 5 s to read the results
+        bench_runPrimitives();
+        wait_seconds(5);
+        bench_runI2C(PBCLK, I2C_SPEED, IMU_ADDRESS, OUT_TEMP_L, 14);
+        wait_seconds(5);
+    }
+
+    if (SHOW_CHART) {
+        plot_accel();
+    }
+
+    lsm6_drdyInit(LSM6_DRDY_XL); // the IMU is read from its data ready pulses from here on
+    calib_start(&calibRun);
+    if (!calib_load(&calib)) {
+        calibrate(); // nothing in flash yet
+    }
+    draw_readings();
+    fusion_init(&fusion, FUSION_GYRO_K(GYRO_MDPS, IMU_ODR), FUSION_KP(2.0, IMU_ODR), FUSION_KI(0.01, IMU_ODR));
+    i2c_sched_clearStats();
+    second = _CP0_GET_COUNT();
         
     while(1) {
-	    // use _CP0_SET_COUNT(0) and _CP0_GET_COUNT() to test the PIC timing
-		// remember the core timer runs at half the CPU speed
-        _CP0_SET_COUNT(0);                   // set core timer to 0
-        
-        while (_CP0_GET_COUNT() < 480000){;} // read at 50 Hz -- 480k / 24 MHz
-               // intialize LED on
-        
-        
-        I2C_read_multiple(IMU_ADDRESS<<1,OUT_TEMP_L,output,14);
-        
-        temp = (output[0] | (output[1] << 8));
-        gyroX = (output[2] | (output[3] << 8));
-        gyroY = (output[4] | (output[5] << 8));
-        gyroZ = (output[6] | (output[7] << 8));
-        accelX = (output[8] | (output[9] << 8));
-        accelY = (output[10] | (output[11] << 8));
-        accelZ = (output[14] | (output[13] << 8));
-        
-        //accelX = accelX/scale;
-        accelXf = ((float)accelX)/scaleA;
-        accelYf = ((float)accelY)/scaleA;
-        accelZf = ((float)accelZ)/scaleA;
-        gyroXf = ((float)gyroX)/scaleG;
-        gyroYf = ((float)gyroY)/scaleG;
-        gyroZf = ((float)gyroZ)/scaleG;
+        if (!PORTBbits.RB4) { // the button calibrates again
+            calibrate();
+            draw_readings();
+            fusion_init(&fusion, FUSION_GYRO_K(GYRO_MDPS, IMU_ODR), FUSION_KP(2.0, IMU_ODR), FUSION_KI(0.01, IMU_ODR));
+        }
+
+        // every reading is corrected and goes through the fusion, and each frame shows the
+        // newest. the drawing sets the frame rate and a reading is never drawn twice
+        while (!lsm6_drdyRead(&imu)) {
+            i2c_engine_tasks(); // gives up on a read the bus has hung on
+        }
+        do {
+            calib_apply(&calib, imu.gyro, imu.accel);
+            fusion_update(&fusion, imu.gyro, imu.accel);
+        } while (lsm6_drdyRead(&imu));
+        fusion_angles(&fusion, &roll, &pitch);
+        temp = imu.temp;
+        gyroX = imu.gyro[0];
+        gyroY = imu.gyro[1];
+        gyroZ = imu.gyro[2];
+        accelX = imu.accel[0];
+        accelY = imu.accel[1];
+        accelZ = imu.accel[2];
         
-        // Write acceleration and gyro values to LCD
-        sprintf(array,"accelX(g): %.2f   ",accelXf);
-        LCD_drawString(5,12,array);
-        sprintf(array,"accelY(g): %.2f   ",accelYf);
-        LCD_drawString(5,27,array);
-        sprintf(array,"accelZ(g): %.2f   ",accelZf);
-        LCD_drawString(5,42,array);
-        sprintf(array,"gyroX(dps): %.2f   ",gyroXf);
-        LCD_drawString(5,57,array);
-        sprintf(array,"gyroY(dps): %.2f   ",gyroYf);
-        LCD_drawString(5,72,array);
-        sprintf(array,"gyroZ(dps): %.2f   ",gyroZf);
-        LCD_drawString(5,87,array);
-        sprintf(array,"TEMP: %i   ",temp);
-        LCD_drawString(5,102,array);
+        // Write acceleration and gyro values to LCD, in hundredths so no floats are needed
+        // only the digits that changed are redrawn
+        field_glyphs = 0;
+        field_setFixed(&values[0], (long)accelX*100/scaleA, 2);
+        field_setFixed(&values[1], (long)accelY*100/scaleA, 2);
+        field_setFixed(&values[2], (long)accelZ*100/scaleA, 2);
+        field_setFixed(&values[3], (long)gyroX*100/scaleG, 2);
+        field_setFixed(&values[4], (long)gyroY*100/scaleG, 2);
+        field_setFixed(&values[5], (long)gyroZ*100/scaleG, 2);
+        field_setInt(&values[6], temp);
+        field_setFixed(&angles[0], roll/10, 1);
+        field_setFixed(&angles[1], pitch/10, 1);
+        field_setInt(&glyphs, field_glyphs);
+        if (_CP0_GET_COUNT() - second >= CORE_TICKS_PER_SEC) { // the IMU's share of the bus over the last second
+            field_setInt(&busLoad, i2c_sched_utilization(&imuBus) / 10);
+            i2c_sched_clearStats();
+            second = _CP0_GET_COUNT();
+        }
+        LCD_flush(); // send what changed when drawing into the framebuffer
         
     }
 }
 
 
 //IMU Setup//
+    static const I2C_DEV imuDev = {IMU_ADDRESS, 1}; // IF_INC in CTRL3_C is on from reset
+    static const I2C_REG imuInit[] = {
+        {0x10, CTRL1_XL},
+        {0x11, CTRL2_G},
+        {0x12, CTRL3_C},
+    };
 
 unsigned char readIMU(char reg){
-    //LATAbits.LATA4 = 1;
-    i2c_master_start();
-    i2c_master_send(IMU_ADDRESS<<1);
-    i2c_master_send(reg);
-    i2c_master_restart();
-    i2c_master_send(0b11010111);
-    unsigned char r = i2c_master_recv();
-    i2c_master_ack(1); 
-    i2c_master_stop(); 
+    unsigned char r = 0;
+    i2c_dev_read(&imuDev, reg, &r, 1);
     return r;
 }
 
+// CTRL1_XL to CTRL3_C follow on from each other, so they go out in one burst
 void init_IMU(void){
-    //init_XL//
-    i2c_master_start(); // make the start bit
-    i2c_master_send(IMU_ADDRESS<<1); // write the address, shifted left by 1, or'ed with a 0 to indicate writing
-    i2c_master_send(0x10); // the register to write to
-    i2c_master_send(CTRL1_XL); // the value to put in the register
-    i2c_master_stop(); // make the stop bit
-    //init_G//
-    i2c_master_start(); // make the start bit
-    i2c_master_send(IMU_ADDRESS<<1); // write the address, shifted left by 1, or'ed with a 0 to indicate writing
-    i2c_master_send(0x11); // the register to write to
-    i2c_master_send(CTRL2_G); // the value to put in the register
-    i2c_master_stop(); // make the stop bit
-    //init_C//
-    i2c_master_start(); // make the start bit
-    i2c_master_send(IMU_ADDRESS<<1); // write the address, shifted left by 1, or'ed with a 0 to indicate writing
-    i2c_master_send(0x12); // the register to write to
-    i2c_master_send(CTRL3_C); // the value to put in the register
-    i2c_master_stop(); // make the stop bit
-}
-
-void I2C_read_multiple(char address, char Register, unsigned char * data, char length){
-    int i = 0;
-    i2c_master_start();
-    i2c_master_send(address);
-    i2c_master_send(Register);
-    i2c_master_restart();
-    i2c_master_send(0b11010111);
-    for (i=0;i<=length;i++){
-    output[i] = i2c_master_recv();
-    if (i<length){
-        i2c_master_ack(0);
-    }
-    else if (i==length){
-        i2c_master_ack(1);
-    }
-    } 
-    i2c_master_stop(); 
+    i2c_dev_init(&imuDev, imuInit, sizeof(imuInit)/sizeof(imuInit[0]));
 }
@@ -0,0 +1,30 @@
+// generated by tools/png2sprite.py, do not edit
+
+#include "sprites.h"
+
+static const unsigned short imu_palette[4] = {
+    0x0000,0xBDF7,0x39E7,0xFFFF
+};
+static const unsigned char imu_data[138] = {
+    0xF0,0x0C,0x01,0x10,0x01,0x10,0x01,0x10,0x01,0x10,0x01,0x10,0x01,0x70,0x01,0x10,
+    0x01,0x10,0x01,0x10,0x01,0x10,0x01,0x10,0x01,0x70,0x01,0x10,0x01,0x10,0x01,0x10,
+    0x01,0x10,0x01,0x10,0x01,0x40,0x21,0xF2,0x00,0x21,0x40,0xF2,0x00,0x70,0x12,0x23,
+    0xA2,0x40,0x21,0x12,0x23,0xA2,0x21,0x40,0x12,0x23,0xA2,0x70,0xF2,0x00,0x40,0x21,
+    0xF2,0x00,0x21,0x40,0xF2,0x00,0x70,0xF2,0x00,0x40,0x21,0xF2,0x00,0x21,0x40,0xF2,
+    0x00,0x70,0xF2,0x00,0x40,0x21,0xF2,0x00,0x21,0x40,0xF2,0x00,0x70,0xF2,0x00,0x40,
+    0x21,0xF2,0x00,0x21,0x40,0x01,0x10,0x01,0x10,0x01,0x10,0x01,0x10,0x01,0x10,0x01,
+    0x70,0x01,0x10,0x01,0x10,0x01,0x10,0x01,0x10,0x01,0x10,0x01,0x70,0x01,0x10,0x01,
+    0x10,0x01,0x10,0x01,0x10,0x01,0x10,0x01,0xF0,0x0C,
+};
+const LCD_SPRITE sprite_imu = {24, 24, 4, imu_palette, imu_data};
+
+static const unsigned short battery_palette[4] = {
+    0xBDF7,0x0000,0x07E0,0x39E7
+};
+static const unsigned char battery_data[52] = {
+    0xF0,0x02,0x11,0x00,0xF1,0x00,0x00,0x11,0x00,0x01,0x92,0x41,0x00,0x11,0x00,0x01,
+    0x92,0x41,0x00,0x13,0x00,0x01,0x92,0x41,0x00,0x13,0x00,0x01,0x92,0x41,0x00,0x13,
+    0x00,0x01,0x92,0x41,0x00,0x13,0x00,0x01,0x92,0x41,0x00,0x11,0x00,0xF1,0x00,0x00,
+    0x11,0xF0,0x02,0x11,
+};
+const LCD_SPRITE sprite_battery = {20, 10, 4, battery_palette, battery_data};
@@ -0,0 +1,11 @@
+// generated by tools/png2sprite.py, do not edit
+
+#ifndef SPRITES_H__
+#define SPRITES_H__
+
+#include "ILI9163C.h"
+
+extern const LCD_SPRITE sprite_imu; // 24x24, 4 colors, 138 bytes
+extern const LCD_SPRITE sprite_battery; // 20x10, 4 colors, 52 bytes
+
+#endif
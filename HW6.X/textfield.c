@@ -0,0 +1,78 @@
+// fixed-width text fields on the ILI9163C
+// each field keeps a copy of what it last drew, and an update only sends the runs of
+// characters that differ, so a number that changes in its last digit costs one glyph
+
+#include "ILI9163C.h"
+#include "textfield.h"
+#include "numfmt.h"
+
+unsigned long field_glyphs = 0;
+
+void field_init(FIELD *f, unsigned short x, unsigned short y, unsigned char width, unsigned short fg, unsigned short bg) {
+    f->x = x;
+    f->y = y;
+    f->width = width > FIELD_MAX ? FIELD_MAX : width;
+    f->fg = fg;
+    f->bg = bg;
+    field_invalidate(f);
+}
+
+void field_invalidate(FIELD *f) {
+    int i;
+    for (i = 0; i <= FIELD_MAX; i++) {
+        f->shown[i] = 0;
+    }
+}
+
+// draw the characters of text that are not already on the LCD, text is f->width long
+static void field_update(FIELD *f, const char *text) {
+    char run[FIELD_MAX+1];
+    int i = 0, start, n;
+
+    while (i < f->width) {
+        if (text[i] == f->shown[i]) {
+            i++;
+            continue;
+        }
+        // a run of changed characters goes out as one block
+        start = i;
+        n = 0;
+        while (i < f->width && text[i] != f->shown[i]) {
+            run[n++] = text[i];
+            f->shown[i] = text[i];
+            i++;
+        }
+        run[n] = 0;
+        LCD_drawStringColor(f->x + 6*start, f->y, run, f->fg, f->bg);
+        field_glyphs += n;
+    }
+}
+
+void field_setText(FIELD *f, const char *text) {
+    char buf[FIELD_MAX];
+    int i;
+
+    for (i = 0; i < f->width && text[i] != 0 && text[i] != '\n'; i++) {
+        buf[i] = text[i];
+    }
+    for (; i < f->width; i++) {
+        buf[i] = ' ';
+    }
+    field_update(f, buf);
+}
+
+void field_setFixed(FIELD *f, long value, unsigned char decimals) {
+    char buf[FIELD_MAX + FMT_MAX];
+    int i;
+
+    if (fmt_fixed(buf, value, decimals, f->width, 0) > f->width) { // too wide for the field
+        for (i = 0; i < f->width; i++) {
+            buf[i] = '#';
+        }
+    }
+    field_update(f, buf);
+}
+
+void field_setInt(FIELD *f, long value) {
+    field_setFixed(f, value, 0);
+}
@@ -0,0 +1,23 @@
+// fixed-width text fields on the ILI9163C that only redraw the characters that changed
+
+#ifndef TEXTFIELD_H__
+#define TEXTFIELD_H__
+
+#define FIELD_MAX 21 // characters, a full line of the LCD
+
+typedef struct {
+    unsigned short x, y; // top left pixel
+    unsigned char width; // characters
+    unsigned short fg, bg; // text and background colors
+    char shown[FIELD_MAX+1]; // what is on the LCD, 0 where it is not known
+} FIELD;
+
+extern unsigned long field_glyphs; // characters drawn by the fields, clear it to count a frame
+
+void field_init(FIELD *f, unsigned short x, unsigned short y, unsigned char width, unsigned short fg, unsigned short bg);
+void field_invalidate(FIELD *f); // draw every character on the next update, e.g. after LCD_clearScreen
+void field_setText(FIELD *f, const char *text); // left aligned, padded with spaces
+void field_setFixed(FIELD *f, long value, unsigned char decimals); // value/10^decimals, right aligned
+void field_setInt(FIELD *f, long value); // right aligned
+
+#endif
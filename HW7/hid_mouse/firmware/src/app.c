@@ -53,8 +53,22 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 // *****************************************************************************
 // *****************************************************************************
 
+#include <xc.h>
 #include "app.h"
 #include "readIMU.h"
+#include "gesture.h"
+#include "telemetry.h"
+
+/* Core timer, half the 48 MHz SYSCLK */
+#define APP_CORE_TICKS_PER_SECOND 24000000
+
+/* A flash write is allowed this long after the device is configured, once
+ * the host has finished setting it up, since the page erase stops
+ * interrupts for about 20 ms */
+#define APP_FLASH_SETTLE_TICKS APP_CORE_TICKS_PER_SECOND
+
+/* Written to the telemetry port, captures a new calibration */
+#define APP_COMMAND_CALIBRATE 'C'
 
 // *****************************************************************************
 // *****************************************************************************
@@ -83,6 +97,14 @@ APP_DATA appData;
 MOUSE_REPORT mouseReport APP_MAKE_BUFFER_DMA_READY;
 MOUSE_REPORT mouseReportPrevious APP_MAKE_BUFFER_DMA_READY;
 
+#if APP_TELEMETRY
+/* Telemetry frames on their way to the host */
+uint8_t telemetryBuffer[TELEMETRY_BATCH * TELEMETRY_FRAME] APP_MAKE_BUFFER_DMA_READY;
+
+/* Commands from the host, a whole packet is read at a time */
+uint8_t commandBuffer[64] APP_MAKE_BUFFER_DMA_READY;
+#endif
+
 
 // *****************************************************************************
 // *****************************************************************************
@@ -103,6 +125,7 @@ void APP_USBDeviceHIDEventHandler(USB_DEVICE_HID_INDEX hidInstance,
              We are free to send another report */
 
             appData->isMouseReportSendBusy = false;
+            appData->reportsSent++;
             break;
 
         case USB_DEVICE_HID_EVENT_REPORT_RECEIVED:
@@ -162,6 +185,79 @@ void APP_USBDeviceHIDEventHandler(USB_DEVICE_HID_INDEX hidInstance,
     }
 }
 
+#if APP_TELEMETRY
+/*******************************************************
+ * USB CDC Device Events - Application Event Handler
+ *******************************************************/
+
+USB_DEVICE_CDC_EVENT_RESPONSE APP_USBDeviceCDCEventHandler
+(
+    USB_DEVICE_CDC_INDEX index ,
+    USB_DEVICE_CDC_EVENT event ,
+    void* pData,
+    uintptr_t userData
+)
+{
+    APP_DATA * appData = (APP_DATA *)userData;
+    USB_DEVICE_CDC_EVENT_DATA_READ_COMPLETE * readComplete;
+    size_t i;
+
+    switch(event)
+    {
+        case USB_DEVICE_CDC_EVENT_GET_LINE_CODING:
+            /* Host is asking for the line coding, send what it last set */
+            USB_DEVICE_ControlSend(appData->deviceHandle,
+                    &appData->getLineCodingData, sizeof(USB_CDC_LINE_CODING));
+            break;
+
+        case USB_DEVICE_CDC_EVENT_SET_LINE_CODING:
+            /* Host is setting the line coding. It is only kept, the
+             * baud rate does not slow the frames down */
+            USB_DEVICE_ControlReceive(appData->deviceHandle,
+                    &appData->setLineCodingData, sizeof(USB_CDC_LINE_CODING));
+            break;
+
+        case USB_DEVICE_CDC_EVENT_CONTROL_TRANSFER_DATA_RECEIVED:
+            /* The line coding from SET LINE CODING is in */
+            appData->getLineCodingData = appData->setLineCodingData;
+            USB_DEVICE_ControlStatus(appData->deviceHandle, USB_DEVICE_CONTROL_STATUS_OK);
+            break;
+
+        case USB_DEVICE_CDC_EVENT_SET_CONTROL_LINE_STATE:
+            /* DTR goes up when a program opens the port */
+            appData->controlLineStateData = *(USB_CDC_CONTROL_LINE_STATE *)pData;
+            USB_DEVICE_ControlStatus(appData->deviceHandle, USB_DEVICE_CONTROL_STATUS_OK);
+            break;
+
+        case USB_DEVICE_CDC_EVENT_WRITE_COMPLETE:
+            /* The host took the frames. We are free to send more */
+            appData->isTelemetryWriteBusy = false;
+            break;
+
+        case USB_DEVICE_CDC_EVENT_READ_COMPLETE:
+            /* A command came in. The next read is started from the
+             * application tasks routine */
+            readComplete = (USB_DEVICE_CDC_EVENT_DATA_READ_COMPLETE *)pData;
+            for(i = 0; i < readComplete->length; i++)
+            {
+                if(commandBuffer[i] == APP_COMMAND_CALIBRATE)
+                {
+                    appData->recalibrate = true;
+                }
+            }
+            appData->isCommandReadBusy = false;
+            break;
+
+        case USB_DEVICE_CDC_EVENT_SEND_BREAK:
+        case USB_DEVICE_CDC_EVENT_CONTROL_TRANSFER_DATA_SENT:
+        default:
+            break;
+    }
+
+    return USB_DEVICE_CDC_EVENT_RESPONSE_NONE;
+}
+#endif
+
 /*******************************************************************************
   Function:
     void APP_USBDeviceEventHandler (USB_DEVICE_EVENT event,
@@ -198,6 +294,11 @@ void APP_USBDeviceEventHandler(USB_DEVICE_EVENT event, void * eventData, uintptr
             
             appData.isConfigured = false;
             appData.isMouseReportSendBusy = false;
+#if APP_TELEMETRY
+            appData.isTelemetryWriteBusy = false;
+            appData.isCommandReadBusy = false;
+            appData.controlLineStateData.dtr = 0;
+#endif
             appData.state = APP_STATE_WAIT_FOR_CONFIGURATION;
             appData.emulateMouse = true;
             //BSP_LEDOn ( APP_USB_LED_1 );
@@ -213,6 +314,7 @@ void APP_USBDeviceEventHandler(USB_DEVICE_EVENT event, void * eventData, uintptr
             if(configurationValue->configurationValue == 1)
             {
                 appData.isConfigured = true;
+                appData.configuredAt = _CP0_GET_COUNT();
                 
 //                BSP_LEDOff ( APP_USB_LED_1 );
 //                BSP_LEDOff ( APP_USB_LED_2 );
@@ -222,6 +324,11 @@ void APP_USBDeviceEventHandler(USB_DEVICE_EVENT event, void * eventData, uintptr
 
                 USB_DEVICE_HID_EventHandlerSet(appData.hidInstance,
                         APP_USBDeviceHIDEventHandler, (uintptr_t)&appData);
+#if APP_TELEMETRY
+                /* And the CDC one, for the telemetry port */
+                USB_DEVICE_CDC_EventHandlerSet(USB_DEVICE_CDC_INDEX_0,
+                        APP_USBDeviceCDCEventHandler, (uintptr_t)&appData);
+#endif
             }
             break;
 
@@ -304,6 +411,56 @@ void APP_USBDeviceEventHandler(USB_DEVICE_EVENT event, void * eventData, uintptr
 //}
 
 
+#if APP_TELEMETRY
+/********************************************************
+ * Application telemetry routine
+ ********************************************************/
+static void APP_TelemetrySend(void)
+{
+    /* The frames wait in the telemetry ring, so the mouse never waits for
+     * them. A batch goes once the last one is done, and while nothing has
+     * the port open the frames are thrown away so the first ones a program
+     * gets are new */
+    uint16_t length;
+
+    if(appData.isTelemetryWriteBusy)
+    {
+        return;
+    }
+    length = telemetry_take(telemetryBuffer, TELEMETRY_BATCH);
+    if(length == 0 || !appData.controlLineStateData.dtr)
+    {
+        return;
+    }
+    appData.isTelemetryWriteBusy = true;
+    if(USB_DEVICE_CDC_Write(USB_DEVICE_CDC_INDEX_0, &appData.telemetryTransferHandle,
+            telemetryBuffer, length, USB_DEVICE_CDC_TRANSFER_FLAGS_DATA_COMPLETE)
+            != USB_DEVICE_CDC_RESULT_OK)
+    {
+        appData.isTelemetryWriteBusy = false;
+    }
+}
+
+/********************************************************
+ * Application command routine
+ ********************************************************/
+static void APP_CommandRead(void)
+{
+    /* One read is always waiting for the host, the CDC event handler looks
+     * at what came in */
+    if(appData.isCommandReadBusy)
+    {
+        return;
+    }
+    appData.isCommandReadBusy = true;
+    if(USB_DEVICE_CDC_Read(USB_DEVICE_CDC_INDEX_0, &appData.commandTransferHandle,
+            commandBuffer, sizeof(commandBuffer)) != USB_DEVICE_CDC_RESULT_OK)
+    {
+        appData.isCommandReadBusy = false;
+    }
+}
+#endif
+
 // *****************************************************************************
 // *****************************************************************************
 // Section: Application Initialization and State Machine Functions
@@ -330,6 +487,27 @@ void APP_Initialize ( void )
     appData.isMouseReportSendBusy = false;
     appData.isSwitchPressed = false;
     appData.ignoreSwitchPress = false;
+    appData.reportsSent = 0;
+    appData.reportsAtSecond = 0;
+    appData.reportsPerSecond = 0;
+    appData.secondStart = _CP0_GET_COUNT();
+    appData.maxTaskTicks = 0;
+    appData.configuredAt = 0;
+    appData.xMotion = 0;
+    appData.yMotion = 0;
+    appData.xAccumulator.residue = 0;
+    appData.yAccumulator.residue = 0;
+#if APP_TELEMETRY
+    appData.isTelemetryWriteBusy = false;
+    appData.isCommandReadBusy = false;
+    appData.recalibrate = false;
+    appData.controlLineStateData.dtr = 0;
+    appData.controlLineStateData.carrier = 0;
+    appData.getLineCodingData.dwDTERate = 921600;
+    appData.getLineCodingData.bCharFormat = 0;
+    appData.getLineCodingData.bParityType = 0;
+    appData.getLineCodingData.bDataBits = 8;
+#endif
 }
 
 
@@ -343,10 +521,11 @@ void APP_Initialize ( void )
 
 void APP_Tasks ( void )
 {
-    float x,y;
+    long x,y;
+    unsigned char buttons;
+    uint32_t start = _CP0_GET_COUNT(), ticks;
     
     static int8_t   vector = 0;
-    static uint8_t  movement_length = 0;
     static bool     sent_dont_move = false;
 
     //int8_t dir_table[] ={-4,-4,-4, 0, 4, 4, 4, 0};
@@ -402,30 +581,52 @@ void APP_Tasks ( void )
                 appData.emulateMouse ^= 1;
                 appData.isSwitchPressed = false;
             }
+#if APP_TELEMETRY
+            /* IMU frames go out as soon as they can, not once a USB frame */
+            APP_TelemetrySend();
+
+            APP_CommandRead();
+            if(appData.recalibrate)
+            {
+                appData.recalibrate = false;
+                IMU_calibrate();
+            }
+#endif
+
+            /* One report per USB frame. The IMU is read and fused in the
+             * background from its data ready pulses and the LCD is drawn
+             * from the main loop, so nothing here waits on either */
+            if(!appData.sofEventHasOccurred)
+            {
+                break;
+            }
+            appData.sofEventHasOccurred = false;
 
             if(appData.emulateMouse)
             {
                 sent_dont_move = false;
 
-                if(movement_length > 50)
+                /* Taps on the board click the buttons */
+                buttons = gesture_report();
+                appData.mouseButton[0] = (buttons & GESTURE_LEFT) ?
+                        MOUSE_BUTTON_STATE_PRESSED : MOUSE_BUTTON_STATE_RELEASED;
+                appData.mouseButton[1] = (buttons & GESTURE_RIGHT) ?
+                        MOUSE_BUTTON_STATE_PRESSED : MOUSE_BUTTON_STATE_RELEASED;
+
+                /* The newest fused reading sets the motion per report */
+                if(IMU_mouseResult(&x, &y))
                 {
-                    x=Read_IMU_Mouse(0x28);
-                    y=Read_IMU_Mouse(0x2A);
-                    
-                    appData.mouseButton[0] = MOUSE_BUTTON_STATE_RELEASED;
-                    appData.mouseButton[1] = MOUSE_BUTTON_STATE_RELEASED;
-                    appData.xCoordinate =-y;
-                    appData.yCoordinate =x;
+                    appData.xMotion =-y;
+                    appData.yMotion =x;
                     vector ++;
-                    movement_length = 0;
                 }
             }
             else
             { 
                 appData.mouseButton[0] = MOUSE_BUTTON_STATE_RELEASED;
                 appData.mouseButton[1] = MOUSE_BUTTON_STATE_RELEASED;
-                appData.xCoordinate = 0;
-                appData.yCoordinate = 0;
+                appData.xMotion = 0;
+                appData.yMotion = 0;
             }
 
             if(!appData.isMouseReportSendBusy)
@@ -438,9 +639,15 @@ void APP_Tasks ( void )
 
                     appData.isMouseReportSendBusy = true;
 
+                    /* The whole counts go in this report, the fraction
+                     * left over waits for the next one */
+
+                    appData.xCoordinate = MOUSE_MotionTake(&appData.xAccumulator, appData.xMotion);
+                    appData.yCoordinate = MOUSE_MotionTake(&appData.yAccumulator, appData.yMotion);
+
                     /* Create the mouse report */
 
-                    MOUSE_ReportCreate(appData.xCoordinate, appData.yCoordinate,
+                    MOUSE_ReportCreate(appData.xCoordinate, appData.yCoordinate, 0,
                             appData.mouseButton, &mouseReport);
 
                     if(memcmp((const void *)&mouseReportPrevious, (const void *)&mouseReport,
@@ -491,7 +698,6 @@ void APP_Tasks ( void )
                             sizeof(MOUSE_REPORT));
                         appData.setIdleTimer = 0;
                     }
-                    movement_length ++;
                     sent_dont_move = true;
                 }
             }
@@ -509,6 +715,41 @@ void APP_Tasks ( void )
             break;
         }
     }
+
+    /* Counters for the LCD. reportsSent is only read here, so the HID
+     * event handler can count it up without turning interrupts off */
+    ticks = _CP0_GET_COUNT() - start;
+    if(ticks > appData.maxTaskTicks)
+    {
+        appData.maxTaskTicks = ticks;
+    }
+    if(_CP0_GET_COUNT() - appData.secondStart >= APP_CORE_TICKS_PER_SECOND)
+    {
+        appData.secondStart += APP_CORE_TICKS_PER_SECOND;
+        appData.reportsPerSecond = appData.reportsSent - appData.reportsAtSecond;
+        appData.reportsAtSecond = appData.reportsSent;
+    }
+}
+
+uint16_t APP_ReportsPerSecond ( void )
+{
+    return appData.reportsPerSecond;
+}
+
+uint32_t APP_MaxTaskMicroseconds ( void )
+{
+    return appData.maxTaskTicks / (APP_CORE_TICKS_PER_SECOND / 1000000);
+}
+
+bool APP_FlashWriteAllowed ( void )
+{
+    return appData.state == APP_STATE_MOUSE_EMULATE
+            && _CP0_GET_COUNT() - appData.configuredAt >= APP_FLASH_SETTLE_TICKS
+            && !appData.isMouseReportSendBusy
+#if APP_TELEMETRY
+            && !appData.isTelemetryWriteBusy
+#endif
+            ;
 }
  
 
@@ -54,6 +54,22 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "system_definitions.h"
 #include "mouse.h"
 
+// *****************************************************************************
+/* IMU Telemetry.
+  Summary:
+    Selects the CDC telemetry port at build time.
+  Description:
+    1 streams every IMU reading as a binary frame (see telemetry.h) over a
+    CDC port next to the mouse. The configuration's descriptors must have
+    the CDC function.
+  Remarks:
+    Set in system_config.h.
+*/
+
+#ifndef APP_TELEMETRY
+#define APP_TELEMETRY 0
+#endif
+
 // *****************************************************************************
 // *****************************************************************************
 // Section: Type Definitions
@@ -122,6 +138,14 @@ typedef struct
     /* Mouse y coordinate*/
     MOUSE_COORDINATE yCoordinate;
 
+    /* Motion per report from the newest IMU reading, in 1/256 counts */
+    int32_t xMotion;
+    int32_t yMotion;
+
+    /* Fractions of a count carried to the next report */
+    MOUSE_ACCUMULATOR xAccumulator;
+    MOUSE_ACCUMULATOR yAccumulator;
+
     /* Mouse buttons*/
     MOUSE_BUTTON_STATE mouseButton[MOUSE_BUTTON_NUMBERS];
 
@@ -143,8 +167,8 @@ typedef struct
     /* Tracks the progress of the report send */
     bool isMouseReportSendBusy;
 
-    /* Flag determines SOF event has occured */
-    bool sofEventHasOccurred;
+    /* Flag determines SOF event has occured, a report is sent for each one */
+    volatile bool sofEventHasOccurred;
 
     /* Switch debounce timer */
     unsigned int switchDebounceTimer;
@@ -152,6 +176,38 @@ typedef struct
     /* SET IDLE timer */
     uint16_t setIdleTimer;
 
+    /* Reports the host has taken, counted up from the HID event handler */
+    uint16_t reportsSent;
+
+    /* reportsSent at the start of the last second, and how many went in it */
+    uint16_t reportsAtSecond;
+    uint16_t reportsPerSecond;
+    uint32_t secondStart;
+
+    /* Longest APP_Tasks call, in core timer ticks */
+    uint32_t maxTaskTicks;
+
+    /* Core timer count when the device was configured */
+    uint32_t configuredAt;
+#if APP_TELEMETRY
+    /* Line coding the host set, only kept to give back, the frames go as
+     * fast as the bus takes them */
+    USB_CDC_LINE_CODING setLineCodingData;
+    USB_CDC_LINE_CODING getLineCodingData;
+    /* DTR says a program has the port open, frames are only sent then */
+    USB_CDC_CONTROL_LINE_STATE controlLineStateData;
+    /* Telemetry transfer handle */
+    USB_DEVICE_CDC_TRANSFER_HANDLE telemetryTransferHandle;
+    /* Tracks the progress of the telemetry write, cleared from the CDC
+     * event handler */
+    volatile bool isTelemetryWriteBusy;
+    /* Command read handle, and the read in progress */
+    USB_DEVICE_CDC_TRANSFER_HANDLE commandTransferHandle;
+    volatile bool isCommandReadBusy;
+    /* The host asked for a new calibration */
+    volatile bool recalibrate;
+#endif
+
 } APP_DATA;
 
 
@@ -222,6 +278,36 @@ void APP_Initialize ( void );
 
 void APP_Tasks ( void );
 
+
+/*******************************************************************************
+  Function:
+    uint16_t APP_ReportsPerSecond ( void )
+    uint32_t APP_MaxTaskMicroseconds ( void )
+  Summary:
+    Counters for showing on the LCD
+  Description:
+    The mouse reports the host took in the last whole second, and the
+    longest APP_Tasks call since reset in microseconds.
+ */
+
+uint16_t APP_ReportsPerSecond ( void );
+uint32_t APP_MaxTaskMicroseconds ( void );
+
+
+/*******************************************************************************
+  Function:
+    bool APP_FlashWriteAllowed ( void )
+  Summary:
+    Whether USB can miss about 20 ms of interrupts
+  Description:
+    True once the device has been configured for a second and no report or
+    telemetry write is going, so a flash page erase can run. Call it and the
+    write from the main loop, outside APP_Tasks, so the write is not in the
+    longest APP_Tasks time.
+ */
+
+bool APP_FlashWriteAllowed ( void );
+
 #endif /* _APP_H */
 /*******************************************************************************
  End of File
@@ -0,0 +1,43 @@
+// taps to mouse clicks
+// the first tap of a double tap is also reported as a single tap, so a single tap is only
+// clicked once the double tap window has gone by without a second one. clicks that come
+// while one is being sent wait their turn, each button at most once
+
+#include "lsm6ds33.h"
+#include "gesture.h"
+
+static unsigned char taps; // LSM6_TAP_ bits from readings since the last report
+static unsigned short single; // reports left until a single tap is clicked, 0 for none
+static unsigned char queued; // buttons waiting to be clicked
+static unsigned char pressed; // button down now
+static unsigned char count; // reports left in this click, down then up
+
+void gesture_tap(unsigned char tap) {
+    taps |= tap;
+}
+
+unsigned char gesture_report(void) {
+    if (taps & LSM6_TAP_DOUBLE) {
+        single = 0;
+        queued |= GESTURE_RIGHT;
+    } else if ((taps & LSM6_TAP_SINGLE) && single == 0) {
+        single = GESTURE_DOUBLE_WINDOW;
+    }
+    taps = 0;
+    if (single && --single == 0) {
+        queued |= GESTURE_LEFT;
+    }
+
+    if (count == 0 && queued) {
+        pressed = queued & -queued; // the lowest bit, left first
+        queued &= ~pressed;
+        count = GESTURE_PRESS + GESTURE_GAP;
+    }
+    if (count) {
+        if (count == GESTURE_GAP) {
+            pressed = 0;
+        }
+        count--;
+    }
+    return pressed;
+}
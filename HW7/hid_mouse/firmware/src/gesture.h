@@ -0,0 +1,19 @@
+// taps to mouse clicks: a single tap clicks the left button and a double tap the right one
+// the tap events come in the IMU readings, and the clicks go out over the reports
+
+#ifndef GESTURE_H__
+#define GESTURE_H__
+
+#define GESTURE_LEFT  0x01 // bits of gesture_report
+#define GESTURE_RIGHT 0x02
+
+#define GESTURE_PRESS 10 // reports a click holds the button down for
+#define GESTURE_GAP 10 // reports it is let go for before the next click
+// a single tap waits this many reports to see if it turns into a double tap, which is as long
+// as the sensor waits for the second tap
+#define GESTURE_DOUBLE_WINDOW 290
+
+void gesture_tap(unsigned char tap); // the tap of each reading, LSM6_TAP_ bits
+unsigned char gesture_report(void); // call once a USB frame, the GESTURE_ buttons that are down in its report
+
+#endif
@@ -53,7 +53,10 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include <stdbool.h>                    // Defines true
 #include <stdlib.h>                     // Defines EXIT_FAILURE
 #include "system/common/sys_module.h" // SYS function prototypes
+#include "app.h"
 #include "readIMU.h"
+#include "i2c_engine.h"
+#include "lsm6ds33.h"
 
 
 // *****************************************************************************
@@ -71,13 +74,22 @@ int main ( void )
     initI2C2();
     SPI1_init();
     LCD_init();
-    init_IMU();
     LCD_clearScreen(BLACK);   
+    i2c_engine_init(0); // IMU reads run from the I2C2 interrupt, so drawing in the loop below cannot hold them up
+    init_IMU();
+    lsm6_drdyInit(LSM6_DRDY_XL); // IMU reads start on its data ready pulses
 
     while ( true )
     {
         /* Maintain state machines of all polled MPLAB Harmony modules. */
         SYS_Tasks ( );
+        i2c_engine_tasks ( );
+        IMU_tasks ( );
+        IMU_display ( APP_ReportsPerSecond ( ), APP_MaxTaskMicroseconds ( ) ); // at most a character a pass, reports go out from APP_Tasks
+        if ( APP_FlashWriteAllowed ( ) )
+        {
+            IMU_calibSave ( ); // a new calibration, once USB can go without interrupts for the erase
+        }
         
 
     }
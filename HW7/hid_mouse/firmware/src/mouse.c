@@ -45,6 +45,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
     (
         MOUSE_COORDINATE x, 
         MOUSE_COORDINATE y,
+        MOUSE_WHEEL wheel,
         MOUSE_BUTTON_STATE * buttonArray,
         MOUSE_REPORT * mouseReport
     )
@@ -65,6 +66,8 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 
     y - Mouse Y Coordinate
 
+    wheel - Wheel detents, left out of the 3 byte report
+
     buttonArray - Pointer to an array of button states. Size of the array is
     defined by USB_HID_MOUSE_BUTTON_NUBMERS.
     
@@ -96,7 +99,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 
     // Create the report.
 
-    MOUSE_ReportCreate( xCoordinate, yCoordinate, 
+    MOUSE_ReportCreate( xCoordinate, yCoordinate, 0,
         mouseButtons, &mouseReport);
 
     // Now send the report
@@ -122,6 +125,7 @@ void MOUSE_ReportCreate
 (
     MOUSE_COORDINATE x,
     MOUSE_COORDINATE y,
+    MOUSE_WHEEL wheel,
     MOUSE_BUTTON_STATE * buttonArray,
     MOUSE_REPORT * mouseReport
 )
@@ -134,14 +138,52 @@ void MOUSE_ReportCreate
     for (index = 0; index < MOUSE_BUTTON_NUMBERS; index ++)
     {
         /* Create the mouse button bit map */
-        mouseReport->data[0] |= buttonArray[index];
+        mouseReport->data[0] |= buttonArray[index] << index;
     }
 
     /* Update the x and y co-ordinate */
+#if MOUSE_HIGH_RES
+    mouseReport->data[1] = (uint16_t)x & 0xFF;
+    mouseReport->data[2] = (uint16_t)x >> 8;
+    mouseReport->data[3] = (uint16_t)y & 0xFF;
+    mouseReport->data[4] = (uint16_t)y >> 8;
+    mouseReport->data[5] = wheel;
+#else
 	mouseReport->data[1] = x;
 	mouseReport->data[2] = y;
+    (void)wheel;
+#endif
 
 	return;	
 }
 
+/* Whole counts are taken toward zero, so the residue keeps the sign of the
+ * motion and is always less than a count */
+MOUSE_COORDINATE MOUSE_MotionTake
+(
+    MOUSE_ACCUMULATOR * accumulator,
+    int32_t motion
+)
+{
+    int32_t counts;
+
+    accumulator->residue += motion;
+    counts = accumulator->residue / MOUSE_MOTION_ONE;
+    if (counts > MOUSE_COORDINATE_MAX)
+    {
+        counts = MOUSE_COORDINATE_MAX;
+    }
+    else if (counts < -MOUSE_COORDINATE_MAX)
+    {
+        counts = -MOUSE_COORDINATE_MAX;
+    }
+    accumulator->residue -= counts * MOUSE_MOTION_ONE;
+    if (accumulator->residue >= MOUSE_MOTION_ONE || accumulator->residue <= -MOUSE_MOTION_ONE)
+    {
+        accumulator->residue %= MOUSE_MOTION_ONE; /* past the range, dropped */
+    }
+
+    return (MOUSE_COORDINATE)counts;
+}
+
 
@@ -61,6 +61,22 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 */
 #define MOUSE_BUTTON_NUMBERS 2
 
+// *****************************************************************************
+/* High Resolution Report.
+  Summary:
+    Selects the report format at build time.
+  Description:
+    0 is the 3 byte report: buttons, then 8 bit X and Y. 1 is the 6 byte
+    report: buttons, 16 bit X and Y (low byte first), then an 8 bit wheel.
+    It must match the report descriptor hid_rpt0 in system_init.c.
+  Remarks:
+    Set in system_config.h.
+*/
+
+#ifndef MOUSE_HIGH_RES
+#define MOUSE_HIGH_RES 0
+#endif
+
 // *****************************************************************************
 /* Mouse Coordinate.
   Summary:
@@ -72,7 +88,36 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
     None.
 */
 
+#if MOUSE_HIGH_RES
+typedef int16_t MOUSE_COORDINATE;
+#define MOUSE_COORDINATE_MAX 32767
+#else
 typedef int8_t MOUSE_COORDINATE; 
+#define MOUSE_COORDINATE_MAX 127
+#endif
+
+/* Wheel detents, only sent in the high resolution report */
+typedef int8_t MOUSE_WHEEL;
+
+// *****************************************************************************
+/* Mouse Motion Accumulator.
+  Summary:
+    Carries the fraction of a count left over from each report.
+  Description:
+    Motion goes in as 1/256 counts. MOUSE_MotionTake() gives the whole counts
+    and keeps the rest for the next report, so a motion of less than a count
+    per report still moves the pointer, a count every few reports.
+  Remarks:
+    Zero it before the first report.
+*/
+
+typedef struct
+{
+    int32_t residue; /* 1/256 counts not sent yet */
+}
+MOUSE_ACCUMULATOR;
+
+#define MOUSE_MOTION_ONE 256 /* one count in MOUSE_MotionTake() units */
 
 // *****************************************************************************
 /*  Mouse Button State.
@@ -110,7 +155,11 @@ MOUSE_BUTTON_STATE;
 
 typedef struct
 {
+#if MOUSE_HIGH_RES
+    uint8_t data[6];
+#else
     uint8_t data[3];
+#endif
 }
 MOUSE_REPORT;
 
@@ -127,6 +176,7 @@ MOUSE_REPORT;
     (
         MOUSE_COORDINATE x, 
         MOUSE_COORDINATE y,
+        MOUSE_WHEEL wheel,
         MOUSE_BUTTON_STATE * buttonArray,
         MOUSE_REPORT * mouseReport
     )
@@ -141,6 +191,7 @@ MOUSE_REPORT;
   Parameters:
     x - Mouse X Coordinate
     y - Mouse Y Coordinate
+    wheel - Wheel detents, left out of the 3 byte report
     buttonArray - Pointer to an array of button states. Size of the array is
     defined by USB_HID_MOUSE_BUTTON_NUBMERS.
     mouseReport - Output only variable that will contain the mouse report.
@@ -164,7 +215,7 @@ MOUSE_REPORT;
     mouseButtons[1] = USB_HID_MOUSE_BUTTON_STATE_RELEASED;
     mouseButtons[2] = USB_HID_MOUSE_BUTTON_STATE_RELEASED;
     // Create the report.
-    MOUSE_ReportCreate( xCoordinate, yCoordinate, 
+    MOUSE_ReportCreate( xCoordinate, yCoordinate, 0,
         mouseButtons, &mouseReport);
     // Now send the report
   
@@ -185,8 +236,32 @@ void MOUSE_ReportCreate
 (
     MOUSE_COORDINATE x,
     MOUSE_COORDINATE y,
+    MOUSE_WHEEL wheel,
     MOUSE_BUTTON_STATE * buttonArray,
     MOUSE_REPORT * mouseReport
 );
 
+// *****************************************************************************
+/* Function:
+    MOUSE_COORDINATE MOUSE_MotionTake
+    (
+        MOUSE_ACCUMULATOR * accumulator,
+        int32_t motion
+    )
+  Summary:
+    Adds motion and takes the whole counts to report.
+  Description:
+    motion is in 1/256 counts. The counts returned are limited to the
+    coordinate's range, and motion past that is dropped rather than sent
+    in later reports.
+  Returns:
+    The counts for this report.
+*/
+
+MOUSE_COORDINATE MOUSE_MotionTake
+(
+    MOUSE_ACCUMULATOR * accumulator,
+    int32_t motion
+);
+
 #endif
\ No newline at end of file
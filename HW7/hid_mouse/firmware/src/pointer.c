@@ -0,0 +1,45 @@
+// tilt to pointer speed
+// past the dead zone the tilt is scaled to a place on the table by one multiply, in 16.16, and
+// the speed is read from the two entries either side of it. the curve starts at 0 at the edge
+// of the dead zone, so a tilt that creeps out of it starts the pointer slowly
+
+#include "pointer.h"
+
+#define POINTER_SPAN (POINTER_FULL - POINTER_DEAD_ZONE)
+#define POINTER_STEP ((POINTER_SEGMENTS * 65536L + POINTER_SPAN - 1) / POINTER_SPAN) // table places per tilt, 16.16
+
+// speed at place k of POINTER_SEGMENTS, in 1/256 counts per report
+#define POINTER_U(k) ((double)(k) / POINTER_SEGMENTS)
+#define POINTER_ENTRY(k) (long)(POINTER_MAX_SPEED * 256 \
+    * (POINTER_LINEAR * POINTER_U(k) + (1 - POINTER_LINEAR) * POINTER_U(k) * POINTER_U(k) * POINTER_U(k)) + 0.5)
+
+static const long pointerTable[POINTER_SEGMENTS + 1] = {
+    POINTER_ENTRY(0), POINTER_ENTRY(1), POINTER_ENTRY(2), POINTER_ENTRY(3),
+    POINTER_ENTRY(4), POINTER_ENTRY(5), POINTER_ENTRY(6), POINTER_ENTRY(7),
+    POINTER_ENTRY(8), POINTER_ENTRY(9), POINTER_ENTRY(10), POINTER_ENTRY(11),
+    POINTER_ENTRY(12), POINTER_ENTRY(13), POINTER_ENTRY(14), POINTER_ENTRY(15),
+    POINTER_ENTRY(16), POINTER_ENTRY(17), POINTER_ENTRY(18), POINTER_ENTRY(19),
+    POINTER_ENTRY(20), POINTER_ENTRY(21), POINTER_ENTRY(22), POINTER_ENTRY(23),
+    POINTER_ENTRY(24), POINTER_ENTRY(25), POINTER_ENTRY(26), POINTER_ENTRY(27),
+    POINTER_ENTRY(28), POINTER_ENTRY(29), POINTER_ENTRY(30), POINTER_ENTRY(31),
+    POINTER_ENTRY(32),
+};
+
+long pointer_transfer(short tilt) {
+    long t = tilt < 0 ? -(long)tilt : tilt;
+    unsigned long place;
+    unsigned int i;
+    long speed;
+
+    if (t <= POINTER_DEAD_ZONE) {
+        return 0;
+    }
+    place = (unsigned long)(t - POINTER_DEAD_ZONE) * POINTER_STEP;
+    i = place >> 16;
+    if (i >= POINTER_SEGMENTS) {
+        speed = pointerTable[POINTER_SEGMENTS];
+    } else {
+        speed = pointerTable[i] + (long)((pointerTable[i+1] - pointerTable[i]) * (place & 0xFFFF) >> 16);
+    }
+    return tilt < 0 ? -speed : speed;
+}
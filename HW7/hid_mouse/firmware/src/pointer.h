@@ -0,0 +1,19 @@
+// tilt to pointer speed: a dead zone, a gain curve from a table, and a top speed
+// the table is worked out by the compiler from the parameters below
+
+#ifndef POINTER_H__
+#define POINTER_H__
+
+// tilts are the Q15 X or Y of the gravity direction, 32768 is 1 g
+#define POINTER_DEAD_ZONE 983 // 0.03 g, about 1.7 degrees, gives no motion
+#define POINTER_FULL 16384 // 0.5 g, 30 degrees, and past it the pointer moves at the top speed
+#define POINTER_MAX_SPEED 8.0 // counts per report at POINTER_FULL
+#define POINTER_LINEAR 0.25 // share of the curve that is linear, the rest grows with the cube of the tilt
+
+#define POINTER_SEGMENTS 32 // table entries - 1, linear in between
+
+// motion per report in 1/256 counts for a tilt, with the tilt's sign. a multiply and a table
+// lookup, no division
+long pointer_transfer(short tilt);
+
+#endif
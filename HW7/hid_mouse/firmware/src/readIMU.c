@@ -1,23 +1,41 @@
 #include<xc.h>           // processor SFR definitions
 #include<sys/attribs.h>  // __ISR macro
-#include <stdio.h>
 #include <math.h> 
+#include <string.h>
 #include "readIMU.h"
+#include "numfmt.h"
+#include "i2c_engine.h"
+#include "lsm6ds33.h"
+#include "fusion.h"
+#include "calib.h"
+#include "i2c_dev.h"
+#include "pointer.h"
+#include "gesture.h"
+#include "telemetry.h"
 
 #define IMU_ADDRESS 0b1101011
 #define OUT_TEMP_L 0x20
 
+// the config bits in system_init.c run the peripheral bus at 48MHz, SYS_CLK_BUS_PERIPHERAL_1
+// still has the starter kit's 80MHz
+#define PBCLK 48000000
+#define I2C_SPEED I2C_FAST // the LSM6DS33 goes up to 400 kHz
+
 //CTRL1,CTRL2,CTRL3 initialize values//
 #define CTRL1_XL 0b10000001
 #define CTRL2_G  0b10000000
 #define CTRL3_C  0b00000100
+#define IMU_ODR 1660 // Hz, CTRL1_XL and CTRL2_G
+#define GYRO_MDPS 8.75 // mdps per LSB at 245 dps, CTRL2_G
 
 //variable initialization//
-    unsigned char output[14];
-    signed short scale = 2000;  // Lower means faster mouse speed
-    signed short temp;
-    float tempf, accel;
-    char array[100];
+    static FUSION fusion; // tilt from the gyro and accel, the mouse follows its gravity direction
+    static unsigned char fused = 0; // a reading went into fusion since the last IMU_mouseResult
+    static CALIB calib; // corrections for every reading
+    static CALIB_RUN calibRun;
+    static unsigned char calibrating = 0; // the board has to be still, readings go to calibRun
+    static unsigned char calibUnsaved = 0; // a capture is in use but not in flash yet, see IMU_calibSave
+    static const char *calibMessage = ""; // top status line, HOLD STILL during a capture
     
 
 static unsigned char pGammaSet[15]= {0x36,0x29,0x12,0x22,0x1C,0x15,0x42,0xB7,0x2F,0x13,0x12,0x0A,0x11,0x0B,0x06};
@@ -27,123 +45,174 @@ static unsigned char nGammaSet[15]= {0x09,0x16,0x2D,0x0D,0x13,0x15,0x40,0x48,0x5
 void initI2C2(void){
     ANSELBbits.ANSB2 = 0;
     ANSELBbits.ANSB3 = 0;
-    //some number for 100kHz; // I2CBRG = [1/(2*Fsck) - PGD]*Pblck - 2
-    I2C2BRG = 233;           // PGD = 104ns, Fsck = 100kHz, Pblck = 48MHz.
-    I2C2CONbits.ON = 1;      // turn on the I2C2 module
+    i2c_engine_setSpeed(PBCLK, I2C_SPEED); // works out I2C2BRG and turns on the I2C2 module
 }
 
-void i2c_master_start(void) {
-    I2C2CONbits.SEN = 1;            // send the start bit
-    while(I2C2CONbits.SEN) { ; }    // wait for the start bit to be sent
+// put every data ready reading through the calibration and the fusion, call from the main
+// loop. with no calibration in flash, or after IMU_calibrate, the readings are a capture for
+// one instead. the capture is used straight away, IMU_calibSave writes it to flash later
+void IMU_tasks(void) {
+    LSM6_READING imu;
+
+    while (lsm6_drdyRead(&imu)) {
+        telemetry_put(&imu); // raw, before the calibration
+        if (calibrating) {
+            if (calib_add(&calibRun, &calib, imu.gyro, imu.accel) == 1) {
+                calibUnsaved = 1;
+                calibrating = 0;
+                calibMessage = "";
+            }
+            continue;
+        }
+        gesture_tap(imu.tap);
+        calib_apply(&calib, imu.gyro, imu.accel);
+        fusion_update(&fusion, imu.gyro, imu.accel);
+        fused = 1;
+    }
 }
 
-void i2c_master_restart(void) {
-    I2C2CONbits.RSEN = 1;           // send a restart
-    while(I2C2CONbits.RSEN) { ; }   // wait for the restart to clear
+// start another capture, the board has to be held still until HOLD STILL goes away. the
+// message is drawn by IMU_display
+void IMU_calibrate(void) {
+    calib_restart(&calibRun);
+    calibrating = 1;
+    calibMessage = "HOLD STILL";
 }
 
-void i2c_master_send(unsigned char byte) { // send a byte to slave
-  I2C2TRN = byte;                   // if an address, bit 0 = 0 for write, 1 for read
-  while(I2C2STATbits.TRSTAT) { ; }  // wait for the transmission to finish
-  if(I2C2STATbits.ACKSTAT) {        // if this is high, slave has not acknowledged
-    // ("I2C2 Master: failed to receive ACK\r\n");
-  }
+// write a new capture to flash, 1 if there was one and it read back. the page erase stops
+// interrupts for about 20 ms, so call it only when APP_FlashWriteAllowed says USB can miss that
+int IMU_calibSave(void) {
+    if (!calibUnsaved) {
+        return 0;
+    }
+    calibUnsaved = 0;
+    return calib_save(&calib);
 }
 
-unsigned char i2c_master_recv(void) { // receive a byte from the slave
-    I2C2CONbits.RCEN = 1;             // start receiving data
-    while(!I2C2STATbits.RBF) { ; }    // wait to receive the data
-    return I2C2RCV;                   // read and return the data
+// 1 with the X and Y of the fused gravity direction through the pointer curve, as motion per
+// report in 1/256 counts, when a reading has come in since the last call, 0 before that. no
+// motion while a capture is going
+int IMU_mouseResult(long *x, long *y) {
+    short g[3];
+
+    if (calibrating) {
+        *x = 0;
+        *y = 0;
+        return 1;
+    }
+    if (!fused) {
+        return 0;
+    }
+    fused = 0;
+    fusion_gravity(&fusion, g);
+    *x = pointer_transfer(g[0]);
+    *y = pointer_transfer(g[1]);
+    return 1;
 }
 
-void i2c_master_ack(int val) {        // sends ACK = 0 (slave should send another byte)
-                                      // or NACK = 1 (no more bytes requested from slave)
-    I2C2CONbits.ACKDT = val;          // store ACK/NACK in ACKDT
-    I2C2CONbits.ACKEN = 1;            // send ACKDT
-    while(I2C2CONbits.ACKEN) { ; }    // wait for ACK/NACK to be sent
+// status lines
+// a character costs about 0.8 ms to draw pixel by pixel, so the lines are kept as text and
+// each call draws only the next character that differs from what is on the LCD. the text is
+// made again from the newest values every DISPLAY_TICKS once what was there has been drawn.
+// the calibration message has the top line, so it is drawn the same way
+#define DISPLAY_LINES 6
+#define DISPLAY_WIDTH 19 // characters across at 6 pixels, from x = 10
+#define DISPLAY_TICKS 2400000 // 100 ms of the core timer
+
+static const unsigned short displayRows[DISPLAY_LINES] = {24, 49, 74, 99, 109, 119};
+static char displayShown[DISPLAY_LINES][DISPLAY_WIDTH]; // 0 for a place nothing is drawn at yet
+static char displayText[DISPLAY_LINES][DISPLAY_WIDTH];
+static unsigned char displayLine, displayColumn; // where the last character was drawn
+static unsigned int displayTime;
+
+// text, padded with spaces to the width
+static void IMU_displayText(int line, const char *text) {
+    int i = 0;
+
+    while (text[i] && i < DISPLAY_WIDTH) {
+        displayText[line][i] = text[i];
+        i++;
+    }
+    while (i < DISPLAY_WIDTH) {
+        displayText[line][i++] = ' ';
+    }
 }
 
-void i2c_master_stop(void) {          // send a STOP:
-  I2C2CONbits.PEN = 1;                // comm is complete and master relinquishes bus
-  while(I2C2CONbits.PEN) { ; }        // wait for STOP to complete
+// label then value, padded with spaces to the width
+static void IMU_displayLine(int line, const char *label, long value, unsigned char decimals) {
+    char number[FMT_MAX];
+    int i = 0, n;
+
+    while (label[i] && i < DISPLAY_WIDTH) {
+        displayText[line][i] = label[i];
+        i++;
+    }
+    fmt_fixed(number, value, decimals, 0, 0);
+    for (n = 0; number[n] && i < DISPLAY_WIDTH; n++) {
+        displayText[line][i++] = number[n];
+    }
+    while (i < DISPLAY_WIDTH) {
+        displayText[line][i++] = ' ';
+    }
 }
 
-float Read_IMU_Mouse(char reg) {
-    
-        I2C_read_multiple(IMU_ADDRESS<<1,reg,output,2);
-        
-        temp = (output[0] | (output[1] << 8));
-        accel=((float)temp)/16383;
-        tempf = ((float)temp)/scale;
-        double f = accel;
-        
-        if (reg==0x28){
-            sprintf(array,"ACCEL_X(g):  %.2f  ",f);
-            LCD_drawString(10,49,array);
+void IMU_display(unsigned short reportsPerSecond, unsigned long maxTaskUs) {
+    short g[3];
+    int i;
+
+    for (i = 0; i < DISPLAY_LINES * DISPLAY_WIDTH; i++) {
+        if (++displayColumn == DISPLAY_WIDTH) {
+            displayColumn = 0;
+            displayLine = (displayLine + 1) % DISPLAY_LINES;
         }
-        else if (reg==0x2A){
-            sprintf(array,"ACCEL_Y(g):  %.2f  ",f);
-            LCD_drawString(10,74,array);
+        if (displayText[displayLine][displayColumn] != displayShown[displayLine][displayColumn]) {
+            displayShown[displayLine][displayColumn] = displayText[displayLine][displayColumn];
+            LCD_drawChar(10 + 6*displayColumn, displayRows[displayLine], displayText[displayLine][displayColumn]);
+            return;
         }
-      
-        return tempf;
     }
 
+    // all drawn
+    if (_CP0_GET_COUNT() - displayTime < DISPLAY_TICKS) {
+        return;
+    }
+    displayTime = _CP0_GET_COUNT();
+    fusion_gravity(&fusion, g);
+    IMU_displayText(0, calibMessage);
+    IMU_displayLine(1, "ACCEL_X(g):  ", (long)(g[0] / 2) * 100 / 16383, 2); // hundredths of a g
+    IMU_displayLine(2, "ACCEL_Y(g):  ", (long)(g[1] / 2) * 100 / 16383, 2);
+    IMU_displayLine(3, "REPORTS/S:   ", reportsPerSecond, 0);
+    IMU_displayLine(4, "MAX TASK US: ", maxTaskUs, 0);
+    IMU_displayLine(5, "I2C TIMEOUTS:", i2c_engine_stats.timeouts, 0); // stays 0 while the reads keep up
+}
+
 
 
 //IMU Setup//
+    static const I2C_DEV imuDev = {IMU_ADDRESS, 1}; // IF_INC in CTRL3_C is on from reset
+    static const I2C_REG imuInit[] = {
+        {0x10, CTRL1_XL},
+        {0x11, CTRL2_G},
+        {0x12, CTRL3_C},
+    };
 
 unsigned char readIMU(char reg){
-    //LATAbits.LATA4 = 1;
-    i2c_master_start();
-    i2c_master_send(IMU_ADDRESS<<1);
-    i2c_master_send(reg);
-    i2c_master_restart();
-    i2c_master_send(0b11010111);
-    unsigned char r = i2c_master_recv();
-    i2c_master_ack(1); 
-    i2c_master_stop(); 
+    unsigned char r = 0;
+    i2c_dev_read(&imuDev, reg, &r, 1);
     return r;
 }
 
+// CTRL1_XL to CTRL3_C follow on from each other, so they go out in one burst
 void init_IMU(void){
-    //init_XL//
-    i2c_master_start(); // make the start bit
-    i2c_master_send(IMU_ADDRESS<<1); // write the address, shifted left by 1, or'ed with a 0 to indicate writing
-    i2c_master_send(0x10); // the register to write to
-    i2c_master_send(CTRL1_XL); // the value to put in the register
-    i2c_master_stop(); // make the stop bit
-    //init_G//
-    i2c_master_start(); // make the start bit
-    i2c_master_send(IMU_ADDRESS<<1); // write the address, shifted left by 1, or'ed with a 0 to indicate writing
-    i2c_master_send(0x11); // the register to write to
-    i2c_master_send(CTRL2_G); // the value to put in the register
-    i2c_master_stop(); // make the stop bit
-    //init_C//
-    i2c_master_start(); // make the start bit
-    i2c_master_send(IMU_ADDRESS<<1); // write the address, shifted left by 1, or'ed with a 0 to indicate writing
-    i2c_master_send(0x12); // the register to write to
-    i2c_master_send(CTRL3_C); // the value to put in the register
-    i2c_master_stop(); // make the stop bit
-}
-
-void I2C_read_multiple(char address, char Register, unsigned char * data, char length){
-    int i = 0;
-    i2c_master_start();
-    i2c_master_send(address);
-    i2c_master_send(Register);
-    i2c_master_restart();
-    i2c_master_send(0b11010111);
-    for (i=0;i<=length;i++){
-    output[i] = i2c_master_recv();
-    if (i<length){
-        i2c_master_ack(0);
-    }
-    else if (i==length){
-        i2c_master_ack(1);
+    i2c_dev_init(&imuDev, imuInit, sizeof(imuInit)/sizeof(imuInit[0]));
+    lsm6_tapInit(); // taps come in with the readings
+    telemetry_init();
+    fusion_init(&fusion, FUSION_GYRO_K(GYRO_MDPS, IMU_ODR), FUSION_KP(2.0, IMU_ODR), FUSION_KI(0.01, IMU_ODR));
+    calib_start(&calibRun);
+    if (!calib_load(&calib)) {
+        calibrating = 1;
+        calibMessage = "HOLD STILL";
     }
-    } 
-    i2c_master_stop(); 
 }
 
 void SPI1_init() {
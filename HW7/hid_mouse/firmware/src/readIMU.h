@@ -3,7 +3,11 @@
 
 #ifndef readIMU_H__
 #define readIMU_H__
-float Read_IMU_Mouse(char reg);
+void IMU_tasks(void); // fuse the readings that came in, call from the main loop
+int IMU_mouseResult(long *x, long *y); // 1 with x and y filled in, in 1/256 counts per report, when there is a new reading
+void IMU_display(unsigned short reportsPerSecond, unsigned long maxTaskUs); // draw a little of the status lines, call from the main loop
+void IMU_calibrate(void); // capture a new calibration, the board has to be still
+int IMU_calibSave(void); // write a new calibration to flash, 1 if there was one, stops interrupts for about 20 ms
 void init_IMU(void);
 void initI2C2(void);
 // lookup table for all of the ascii characters
@@ -177,7 +181,6 @@ void LCD_drawPixel(unsigned short, unsigned short, unsigned short); // set the x
 void LCD_setAddr(unsigned short, unsigned short, unsigned short, unsigned short); // set the memory address you are writing to
 void LCD_clearScreen(unsigned short); // set the color of every pixel
 unsigned char readIMU(char reg);
-void I2C_read_multiple(char address, char Register, unsigned char * data, char length);
 void LCD_drawChar(unsigned short, unsigned short, char);
 void LCD_drawString(unsigned short x, unsigned short y, char *array);
 
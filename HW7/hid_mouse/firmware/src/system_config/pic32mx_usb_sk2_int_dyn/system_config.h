@@ -132,8 +132,9 @@ extern "C" {
 #define DRV_USBFS_INTERRUPT_MODE      true
 
 
-/* Number of Endpoints used */
-#define DRV_USBFS_ENDPOINTS_NUMBER    2
+/* Number of Endpoints used, EP0, EP1 for the mouse, EP2 and EP3 for the
+   telemetry port */
+#define DRV_USBFS_ENDPOINTS_NUMBER    4
 
 
 
@@ -185,6 +186,14 @@ extern "C" {
    function driver */
 #define USB_DEVICE_HID_QUEUE_DEPTH_COMBINED 2
 
+/* Maximum instances of CDC function driver */
+#define USB_DEVICE_CDC_INSTANCES_NUMBER     1
+
+/* CDC Transfer Queue Size for both read and
+   write. Applicable to all instances of the
+   function driver */
+#define USB_DEVICE_CDC_QUEUE_DEPTH_COMBINED 3
+
 
 
 
@@ -203,6 +212,12 @@ extern "C" {
 /* Macro defines USB internal DMA Buffer criteria*/
 #define APP_MAKE_BUFFER_DMA_READY
 
+/* 16 bit X and Y and a wheel in the mouse report, see mouse.h */
+#define MOUSE_HIGH_RES 1
+
+/* IMU frames on a CDC port next to the mouse, see telemetry.h */
+#define APP_TELEMETRY 1
+
 /* Macros defines board specific led */
 #define APP_USB_LED_1    BSP_LED_1
 
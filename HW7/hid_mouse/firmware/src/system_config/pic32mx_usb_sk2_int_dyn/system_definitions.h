@@ -62,6 +62,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 
 
 #include "usb/usb_device_hid.h"
+#include "usb/usb_device_cdc.h"
 #include "app.h"
 
 
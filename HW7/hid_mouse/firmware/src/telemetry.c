@@ -0,0 +1,60 @@
+// IMU readings to CDC frames
+// frames are packed byte by byte when they go in, so taking them out is only copies
+
+#include "ring.h"
+#include "telemetry.h"
+
+unsigned long telemetry_dropped = 0;
+
+static unsigned char telemetryFrames[TELEMETRY_RING][TELEMETRY_FRAME];
+static RING ring;
+static unsigned char sequence;
+
+static unsigned char *telemetry_put16(unsigned char *p, short v) {
+    *p++ = (unsigned short)v & 0xFF;
+    *p++ = (unsigned short)v >> 8;
+    return p;
+}
+
+void telemetry_init(void) {
+    ring_init(&ring, telemetryFrames, TELEMETRY_FRAME, TELEMETRY_RING);
+    sequence = 0;
+}
+
+void telemetry_put(const LSM6_READING *r) {
+    unsigned char frame[TELEMETRY_FRAME], *p = frame, sum = 0;
+    int i;
+
+    *p++ = TELEMETRY_SYNC0;
+    *p++ = TELEMETRY_SYNC1;
+    *p++ = sequence++;
+    *p++ = r->tap;
+    *p++ = r->time & 0xFF;
+    *p++ = (r->time >> 8) & 0xFF;
+    *p++ = (r->time >> 16) & 0xFF;
+    *p++ = r->time >> 24;
+    p = telemetry_put16(p, r->temp);
+    for (i = 0; i < 3; i++) {
+        p = telemetry_put16(p, r->gyro[i]);
+    }
+    for (i = 0; i < 3; i++) {
+        p = telemetry_put16(p, r->accel[i]);
+    }
+    for (i = 2; i < TELEMETRY_FRAME - 1; i++) {
+        sum += frame[i];
+    }
+    *p = sum;
+
+    if (!ring_put(&ring, frame)) {
+        telemetry_dropped++;
+    }
+}
+
+unsigned short telemetry_take(unsigned char *buf, unsigned short frames) {
+    unsigned short n = 0;
+
+    while (n < frames && ring_get(&ring, buf + n * TELEMETRY_FRAME)) {
+        n++;
+    }
+    return n * TELEMETRY_FRAME;
+}
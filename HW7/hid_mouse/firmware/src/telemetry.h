@@ -0,0 +1,33 @@
+// IMU readings as binary frames for the CDC port: every data ready reading is packed into a
+// ring in the main loop, and the USB side takes whole frames out when its last write is done,
+// so a slow or closed port drops frames instead of holding up the mouse
+// the other way, a C written to the port captures a new calibration, see app.c
+
+#ifndef TELEMETRY_H__
+#define TELEMETRY_H__
+
+#include "lsm6ds33.h"
+
+// a frame, multi byte values low byte first:
+//  0  0xA5 0x5A
+//  2  sequence, one more for every reading, so a gap shows frames were dropped
+//  3  tap, LSM6_TAP_ bits
+//  4  time, core timer count at the data ready pulse, 32 bits
+//  8  temp, 16 bits
+// 10  gyro x y z, 16 bits each, raw
+// 16  accel x y z, 16 bits each, raw
+// 22  sum of bytes 2 to 21
+#define TELEMETRY_SYNC0 0xA5
+#define TELEMETRY_SYNC1 0x5A
+#define TELEMETRY_FRAME 23 // bytes
+#define TELEMETRY_RING 64 // frames kept, about 38 ms at 1.66 kHz, a power of two
+#define TELEMETRY_BATCH 11 // most frames in one write, 253 bytes
+
+extern unsigned long telemetry_dropped; // frames lost because the ring was full
+
+void telemetry_init(void);
+void telemetry_put(const LSM6_READING *r); // pack a reading, call for every one
+// copy up to frames waiting frames into buf, one after the other, and return how many bytes that is
+unsigned short telemetry_take(unsigned char *buf, unsigned short frames);
+
+#endif
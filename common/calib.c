@@ -0,0 +1,235 @@
+// IMU calibration
+// a capture averages CALIB_SAMPLES readings taken while the board is still. the gyro should
+// read 0, so its mean is the bias. the accel axis with the largest mean is the one pointing up
+// or down and should read +-1 g, the other two should read 0. an axis that has been captured
+// both ways gets its bias from the middle of the two and its scale from the distance between
+// them. the result is kept as one record in the last 1 KB page of program flash, which the
+// linker is told to leave alone, so boot does not have to calibrate again. programming the
+// PIC erases it, unless the page is excluded in the programmer's memory settings
+
+#include <xc.h>
+#include <sys/kmem.h>
+#include "calib.h"
+
+#define CALIB_ADDRESS 0x9D01FC00 // last page of the 128 KB of flash
+#define CALIB_PAGE_WORDS 256
+#define CALIB_MAGIC 0x43414C31 // "CAL1"
+#define CALIB_WORDS 7 // magic, 5 words of shorts, checksum
+
+#define NVMOP_WORD_PGM 0x4001 // NVMCON values with WREN set
+#define NVMOP_PAGE_ERASE 0x4004
+#define NVMCON_WR 0x8000
+#define NVMCON_WREN 0x4000
+#define NVMCON_ERR 0x3000 // WRERR, LVDERR
+
+// reserved in flash but not programmed, volatile because calib_save changes it under the compiler
+static const volatile unsigned int __attribute__((space(prog), address(CALIB_ADDRESS), noload)) calibFlash[CALIB_PAGE_WORDS];
+
+// start an NVM operation and wait for it, 0 if it went through. interrupts are off for the
+// unlock sequence and the CPU stalls until the flash is done anyway
+static unsigned int calib_nvm(unsigned int op) {
+    unsigned int status, start;
+
+    status = __builtin_disable_interrupts();
+    NVMCON = op;
+    start = _CP0_GET_COUNT();
+    while (_CP0_GET_COUNT() - start < 24*6) {;} // 6 us for the voltage detector to start
+    NVMKEY = 0xAA996655;
+    NVMKEY = 0x556699AA;
+    NVMCONSET = NVMCON_WR;
+    while (NVMCON & NVMCON_WR) {;}
+    NVMCONCLR = NVMCON_WREN;
+    if (status & 1) {
+        __builtin_enable_interrupts();
+    }
+    return NVMCON & NVMCON_ERR;
+}
+
+static unsigned int calib_pack(short lo, short hi) {
+    return (unsigned short)lo | ((unsigned int)(unsigned short)hi << 16);
+}
+
+// the record as it goes in flash
+static void calib_record(const CALIB *c, unsigned int *w) {
+    int i;
+
+    w[0] = CALIB_MAGIC;
+    w[1] = calib_pack(c->gyroBias[0], c->gyroBias[1]);
+    w[2] = calib_pack(c->gyroBias[2], c->accelBias[0]);
+    w[3] = calib_pack(c->accelBias[1], c->accelBias[2]);
+    w[4] = calib_pack(c->accelScale[0], c->accelScale[1]);
+    w[5] = calib_pack(c->accelScale[2], 0);
+    w[6] = 0;
+    for (i = 0; i < CALIB_WORDS - 1; i++) {
+        w[6] += w[i] ^ (w[6] << 5);
+    }
+}
+
+void calib_default(CALIB *c) {
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        c->gyroBias[i] = 0;
+        c->accelBias[i] = 0;
+        c->accelScale[i] = 16384;
+    }
+    calib_prepare(c);
+}
+
+void calib_prepare(CALIB *c) {
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        c->mul[i] = 16384;
+        c->add[i] = -(long)c->gyroBias[i] * 16384;
+        c->mul[3+i] = c->accelScale[i];
+        c->add[3+i] = -(long)c->accelBias[i] * c->accelScale[i];
+    }
+}
+
+int calib_load(CALIB *c) {
+    unsigned int w[CALIB_WORDS];
+    int i;
+
+    for (i = 0; i < CALIB_WORDS; i++) {
+        w[i] = calibFlash[i];
+    }
+    c->gyroBias[0] = w[1];
+    c->gyroBias[1] = w[1] >> 16;
+    c->gyroBias[2] = w[2];
+    c->accelBias[0] = w[2] >> 16;
+    c->accelBias[1] = w[3];
+    c->accelBias[2] = w[3] >> 16;
+    c->accelScale[0] = w[4];
+    c->accelScale[1] = w[4] >> 16;
+    c->accelScale[2] = w[5];
+
+    // the checksum is worked out again from what was just unpacked
+    calib_record(c, w);
+    for (i = 0; i < CALIB_WORDS; i++) {
+        if (w[i] != calibFlash[i]) {
+            calib_default(c);
+            return 0;
+        }
+    }
+    calib_prepare(c);
+    return 1;
+}
+
+int calib_save(CALIB *c) {
+    unsigned int w[CALIB_WORDS];
+    int i;
+
+    calib_prepare(c);
+    calib_record(c, w);
+    NVMADDR = KVA_TO_PA(CALIB_ADDRESS);
+    if (calib_nvm(NVMOP_PAGE_ERASE)) {
+        return 0;
+    }
+    for (i = 0; i < CALIB_WORDS; i++) {
+        NVMADDR = KVA_TO_PA(CALIB_ADDRESS + 4*i);
+        NVMDATA = w[i];
+        if (calib_nvm(NVMOP_WORD_PGM) || calibFlash[i] != w[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void calib_start(CALIB_RUN *r) {
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        r->plus[i] = 0;
+        r->minus[i] = 0;
+    }
+    calib_restart(r);
+}
+
+void calib_restart(CALIB_RUN *r) {
+    int i;
+
+    for (i = 0; i < 6; i++) {
+        r->sum[i] = 0;
+        r->lo[i] = 32767;
+        r->hi[i] = -32768;
+    }
+    r->count = 0;
+}
+
+// a capture is done, work out the biases and scales it gives
+static void calib_finish(CALIB_RUN *r, CALIB *c) {
+    short *m = r->mean;
+    int i, up = 0;
+
+    for (i = 0; i < 6; i++) {
+        m[i] = r->sum[i] / CALIB_SAMPLES;
+    }
+    for (i = 0; i < 3; i++) {
+        c->gyroBias[i] = m[i];
+    }
+    for (i = 1; i < 3; i++) { // the accel axis that is up or down
+        if ((m[3+i] < 0 ? -m[3+i] : m[3+i]) > (m[3+up] < 0 ? -m[3+up] : m[3+up])) {
+            up = i;
+        }
+    }
+    if (m[3+up] > 0) {
+        r->plus[up] = m[3+up];
+    } else {
+        r->minus[up] = m[3+up];
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (r->plus[i] && r->minus[i] && r->plus[i] - r->minus[i] > CALIB_ONE_G) {
+            c->accelBias[i] = (r->plus[i] + r->minus[i]) / 2;
+            c->accelScale[i] = (long)2 * CALIB_ONE_G * 16384 / (r->plus[i] - r->minus[i]);
+        } else if (i == up) {
+            c->accelBias[i] = m[3+i] - (m[3+i] > 0 ? CALIB_ONE_G : -CALIB_ONE_G);
+        } else {
+            c->accelBias[i] = m[3+i];
+        }
+    }
+    calib_prepare(c);
+}
+
+int calib_add(CALIB_RUN *r, CALIB *c, const short *gyro, const short *accel) {
+    short v;
+    int i;
+
+    for (i = 0; i < 6; i++) {
+        v = i < 3 ? gyro[i] : accel[i-3];
+        r->sum[i] += v;
+        if (v < r->lo[i]) {
+            r->lo[i] = v;
+        }
+        if (v > r->hi[i]) {
+            r->hi[i] = v;
+        }
+        if (r->hi[i] - r->lo[i] > (i < 3 ? CALIB_GYRO_STILL : CALIB_ACCEL_STILL)) {
+            calib_restart(r);
+            return -1;
+        }
+    }
+    if (++r->count < CALIB_SAMPLES) {
+        return 0;
+    }
+    calib_finish(r, c);
+    calib_restart(r);
+    return 1;
+}
+
+// (raw * mul + add) / 16384, which is (raw - bias) * scale
+static short calib_one(short raw, short mul, long add) {
+    long v = ((long)raw * mul + add) >> 14;
+
+    return v > 32767 ? 32767 : v < -32768 ? -32768 : (short)v;
+}
+
+void calib_apply(const CALIB *c, short *gyro, short *accel) {
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        gyro[i] = calib_one(gyro[i], c->mul[i], c->add[i]);
+        accel[i] = calib_one(accel[i], c->mul[3+i], c->add[3+i]);
+    }
+}
@@ -0,0 +1,45 @@
+// IMU bias and scale calibration, kept in the last page of program flash
+// shared by HW6.X and HW7
+
+#ifndef CALIB_H__
+#define CALIB_H__
+
+#define CALIB_SAMPLES 1024 // readings averaged in one capture, 0.6 s at 1.66 kHz
+#define CALIB_ONE_G 16384 // raw accel for 1 g at +-2 g
+#define CALIB_GYRO_STILL 200 // most a gyro axis can change during a capture, about 1.75 dps
+#define CALIB_ACCEL_STILL 400 // most an accel axis can change, about 0.025 g
+
+// what is stored, and the multiply and add it turns into so calib_apply is one of each per axis
+typedef struct {
+    short gyroBias[3];
+    short accelBias[3];
+    short accelScale[3]; // Q14, 16384 leaves the reading as it is
+    short mul[6]; // gyro x y z then accel x y z, Q14
+    long add[6]; // Q14
+} CALIB;
+
+// a capture in progress. captures with different sides of the board down add up, once an axis
+// has been captured pointing up and pointing down its accel scale is known too
+typedef struct {
+    long sum[6];
+    short lo[6], hi[6];
+    unsigned short count;
+    short plus[3], minus[3]; // accel mean of an axis pointing up, and down, 0 until captured
+    short mean[6]; // of the last capture
+} CALIB_RUN;
+
+void calib_default(CALIB *c); // no bias, unit scale
+int calib_load(CALIB *c); // 1 with the calibration in flash, 0 and calib_default if there is none
+int calib_save(CALIB *c); // erase the flash page and write c, 1 if it reads back the same
+void calib_prepare(CALIB *c); // work out mul and add from the biases and scales
+
+void calib_start(CALIB_RUN *r); // forget every capture
+void calib_restart(CALIB_RUN *r); // start a new capture, keeping the earlier ones
+// 0 while collecting, 1 when CALIB_SAMPLES still readings are in and c has been updated,
+// -1 if the board moved and the capture started over
+int calib_add(CALIB_RUN *r, CALIB *c, const short *gyro, const short *accel);
+
+// the hot path, correct one reading in place
+void calib_apply(const CALIB *c, short *gyro, short *accel);
+
+#endif
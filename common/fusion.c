@@ -0,0 +1,203 @@
+// fixed point Mahony filter
+// the orientation is a Q30 quaternion. each update the gravity direction it predicts is crossed
+// with the measured accel, and that error is fed back into the gyro rates (proportional and
+// integral) before they turn the quaternion. the gyro rates are used as half angles per update,
+// so the quaternion step is only multiplies and adds, and the quaternion is pulled back to unit
+// length with one Newton step instead of a square root. all products are 32 x 32 to 64 bits,
+// which the PIC32 does in one instruction. the widths are fixed, so a 64 bit host runs the same
+// arithmetic
+
+#include "fusion.h"
+
+#define Q30 ((int32_t)1073741824)
+#define FUSION_INTEGRAL_MAX ((int64_t)1 << 60) // Q70, 1/1024 of a turn per update is far past any gyro bias
+
+// atan(2^-i) in hundredths of a degree, Q8
+static const int32_t atanTable[16] = {1152000, 680065, 359328, 182400, 91554, 45822, 22916, 11459,
+    5730, 2865, 1432, 716, 358, 179, 90, 45};
+
+#define CORDIC_INV_GAIN 19898 // 1/1.64676, Q15
+
+static uint32_t fusion_isqrt(uint32_t n) {
+    uint32_t root = 0, bit = (uint32_t)1 << 30;
+
+    while (bit > n) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+static int32_t fusion_mul(int32_t a, int32_t b) { // Q30 * Q30
+    return (int32_t)(((int64_t)a * b) >> 30);
+}
+
+// accel scaled to length 1, Q15, 0 if it is all zeros
+static int fusion_normalize(const short *accel, int32_t *a) {
+    uint32_t n;
+    int i;
+
+    n = (uint32_t)((int32_t)accel[0]*accel[0]) + (uint32_t)((int32_t)accel[1]*accel[1])
+        + (uint32_t)((int32_t)accel[2]*accel[2]);
+    n = fusion_isqrt(n);
+    if (n == 0) {
+        return 0;
+    }
+    for (i = 0; i < 3; i++) {
+        a[i] = (int32_t)accel[i] * 32768 / (int32_t)n;
+    }
+    return 1;
+}
+
+// the quaternion that turns flat gravity (0, 0, 1) into a, the shortest way
+static void fusion_start(FUSION *f, const int32_t *a) {
+    int32_t v[4];
+    uint32_t m;
+    int i;
+
+    v[0] = (32768 + a[2]) >> 1; // Q14 so the squares fit
+    v[1] = a[1] >> 1;
+    v[2] = -a[0] >> 1;
+    v[3] = 0;
+    m = fusion_isqrt((uint32_t)(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]));
+    if (m < 32) { // upside down, any half turn about a level axis works
+        f->q[0] = 0;
+        f->q[1] = Q30;
+        f->q[2] = 0;
+        f->q[3] = 0;
+        return;
+    }
+    for (i = 0; i < 4; i++) {
+        f->q[i] = (int32_t)((int64_t)v[i] * Q30 / (int32_t)m);
+    }
+}
+
+void fusion_init(FUSION *f, int32_t gyroK, int32_t kp, int32_t ki) {
+    int i;
+
+    f->q[0] = Q30;
+    f->q[1] = 0;
+    f->q[2] = 0;
+    f->q[3] = 0;
+    for (i = 0; i < 3; i++) {
+        f->integral[i] = 0;
+    }
+    f->gyroK = gyroK;
+    f->kp = kp;
+    f->ki = ki;
+    f->started = 0;
+}
+
+// gravity in the sensor frame from the quaternion, as the accel would read it, Q15
+static void fusion_expected(const int32_t *q, int32_t *v) {
+    v[0] = (int32_t)(((int64_t)q[1]*q[3] - (int64_t)q[0]*q[2]) >> 44);
+    v[1] = (int32_t)(((int64_t)q[0]*q[1] + (int64_t)q[2]*q[3]) >> 44);
+    v[2] = (int32_t)(((int64_t)q[0]*q[0] - (int64_t)q[1]*q[1] - (int64_t)q[2]*q[2]
+        + (int64_t)q[3]*q[3]) >> 45);
+}
+
+void fusion_update(FUSION *f, const short *gyro, const short *accel) {
+    int32_t a[3], v[3], e[3], h[3], q[4];
+    int64_t n;
+    int32_t scale;
+    int i, haveAccel;
+
+    haveAccel = fusion_normalize(accel, a);
+    if (!f->started && haveAccel) {
+        fusion_start(f, a);
+        f->started = 1;
+        return;
+    }
+
+    for (i = 0; i < 3; i++) {
+        h[i] = (int32_t)(((int64_t)gyro[i] * f->gyroK) >> 14); // Q30 half angle
+    }
+
+    if (haveAccel) {
+        // error between where gravity is measured and where the quaternion has it, Q30
+        fusion_expected(f->q, v);
+        e[0] = a[1]*v[2] - a[2]*v[1];
+        e[1] = a[2]*v[0] - a[0]*v[2];
+        e[2] = a[0]*v[1] - a[1]*v[0];
+        for (i = 0; i < 3; i++) {
+            f->integral[i] += (int64_t)e[i] * f->ki;
+            if (f->integral[i] > FUSION_INTEGRAL_MAX) {
+                f->integral[i] = FUSION_INTEGRAL_MAX;
+            } else if (f->integral[i] < -FUSION_INTEGRAL_MAX) {
+                f->integral[i] = -FUSION_INTEGRAL_MAX;
+            }
+            h[i] += (int32_t)(((int64_t)e[i] * f->kp) >> 30) + (int32_t)(f->integral[i] >> 40);
+        }
+    }
+
+    // q += q * (0, h)
+    q[0] = f->q[0] - fusion_mul(f->q[1], h[0]) - fusion_mul(f->q[2], h[1]) - fusion_mul(f->q[3], h[2]);
+    q[1] = f->q[1] + fusion_mul(f->q[0], h[0]) + fusion_mul(f->q[2], h[2]) - fusion_mul(f->q[3], h[1]);
+    q[2] = f->q[2] + fusion_mul(f->q[0], h[1]) - fusion_mul(f->q[1], h[2]) + fusion_mul(f->q[3], h[0]);
+    q[3] = f->q[3] + fusion_mul(f->q[0], h[2]) + fusion_mul(f->q[1], h[1]) - fusion_mul(f->q[2], h[0]);
+
+    // one Newton step of 1/sqrt, the length is always close to 1
+    n = 0;
+    for (i = 0; i < 4; i++) {
+        n += (int64_t)q[i] * q[i];
+    }
+    scale = (int32_t)((3*(int64_t)Q30 - (n >> 30)) >> 1);
+    for (i = 0; i < 4; i++) {
+        f->q[i] = fusion_mul(q[i], scale);
+    }
+}
+
+void fusion_gravity(const FUSION *f, short *g) {
+    int32_t v[3];
+    int i;
+
+    fusion_expected(f->q, v);
+    for (i = 0; i < 3; i++) {
+        g[i] = v[i] > 32767 ? 32767 : v[i] < -32767 ? -32767 : (short)v[i];
+    }
+}
+
+// CORDIC, the angle of (x, y) in hundredths of a degree, Q8, and its length times the gain
+static int32_t fusion_atan2(int32_t y, int32_t x, int32_t *length) {
+    int32_t angle = 0, t;
+    int i;
+
+    if (x < 0) { // turn by half a circle so the rotations below can reach it
+        angle = y >= 0 ? 18000*256 : -18000*256;
+        x = -x;
+        y = -y;
+    }
+    for (i = 0; i < 16; i++) {
+        t = x;
+        if (y > 0) {
+            x += y >> i;
+            y -= t >> i;
+            angle += atanTable[i];
+        } else {
+            x -= y >> i;
+            y += t >> i;
+            angle -= atanTable[i];
+        }
+    }
+    if (length) {
+        *length = x;
+    }
+    return angle;
+}
+
+void fusion_angles(const FUSION *f, short *roll, short *pitch) {
+    int32_t v[3], across;
+
+    fusion_expected(f->q, v);
+    *roll = (short)((fusion_atan2(v[1], v[2], &across) + 128) >> 8);
+    across = (across * CORDIC_INV_GAIN) >> 15;
+    *pitch = (short)((fusion_atan2(-v[0], across, 0) + 128) >> 8);
+}
@@ -0,0 +1,30 @@
+// fixed point Mahony filter, fuses gyro and accel readings into an orientation without floats
+// shared by HW6.X and HW7
+
+#ifndef FUSION_H__
+#define FUSION_H__
+
+#include <stdint.h>
+
+// gains for fusion_init, worked out by the compiler from the sensor settings. mdps is the gyro
+// sensitivity in mdps per LSB (8.75 at 245 dps), hz the rate fusion_update is called at, kp and
+// ki the filter gains in 1/s, about 2 and 0.01 are a good start
+#define FUSION_GYRO_K(mdps, hz) ((int32_t)((mdps) * 3.14159265 / 180000.0 / 2.0 / (hz) * 17592186044416.0)) // Q44
+#define FUSION_KP(kp, hz) ((int32_t)((kp) / 2.0 / (hz) * 1073741824.0)) // Q30
+#define FUSION_KI(ki, hz) ((int32_t)((ki) / 2.0 / (hz) / (hz) * 1099511627776.0)) // Q40
+
+typedef struct {
+    int32_t q[4]; // orientation quaternion w x y z, Q30
+    int64_t integral[3]; // gyro bias the integral term has learned, Q70 half angle per update
+    int32_t gyroK; // raw gyro to half angle per update, Q44
+    int32_t kp; // accel error to half angle per update, Q30
+    int32_t ki; // accel error to integral, Q40
+    unsigned char started; // the first accel reading has set q
+} FUSION;
+
+void fusion_init(FUSION *f, int32_t gyroK, int32_t kp, int32_t ki);
+void fusion_update(FUSION *f, const short *gyro, const short *accel); // one raw x y z reading of each
+void fusion_gravity(const FUSION *f, short *g); // x y z of gravity as the accel reads it, Q15, 0 0 32767 when flat
+void fusion_angles(const FUSION *f, short *roll, short *pitch); // in hundredths of a degree
+
+#endif
@@ -0,0 +1,82 @@
+// register map access to an I2C device
+// a device that steps its register address on by itself takes a run of registers in one
+// transaction, so i2c_dev_init sends each run in the table as one burst: the address and
+// register byte go out once instead of once per register
+
+#include "i2c_engine.h"
+#include "i2c_dev.h"
+
+#define I2C_DEV_BURST 32 // most registers i2c_dev_init puts in one burst
+
+signed char i2c_dev_write(const I2C_DEV *dev, unsigned char reg, const unsigned char *values, unsigned char len) {
+    I2C_TXN txn;
+    unsigned char i;
+    signed char status;
+
+    if (dev->autoIncrement) {
+        i2c_engine_write(&txn, dev->address, reg, values, len, 0);
+        return i2c_engine_wait(&txn);
+    }
+    for (i = 0; i < len; i++) {
+        i2c_engine_write(&txn, dev->address, reg + i, &values[i], 1, 0);
+        status = i2c_engine_wait(&txn);
+        if (status != I2C_DONE) {
+            return status;
+        }
+    }
+    return I2C_DONE;
+}
+
+signed char i2c_dev_read(const I2C_DEV *dev, unsigned char reg, unsigned char *values, unsigned char len) {
+    I2C_TXN txn;
+    unsigned char i;
+    signed char status;
+
+    if (dev->autoIncrement) {
+        i2c_engine_read(&txn, dev->address, reg, values, len, 0);
+        return i2c_engine_wait(&txn);
+    }
+    for (i = 0; i < len; i++) {
+        i2c_engine_read(&txn, dev->address, reg + i, &values[i], 1, 0);
+        status = i2c_engine_wait(&txn);
+        if (status != I2C_DONE) {
+            return status;
+        }
+    }
+    return I2C_DONE;
+}
+
+signed char i2c_dev_update(const I2C_DEV *dev, unsigned char reg, unsigned char mask, unsigned char bits) {
+    unsigned char value;
+    signed char status;
+
+    status = i2c_dev_read(dev, reg, &value, 1);
+    if (status != I2C_DONE) {
+        return status;
+    }
+    value = (value & ~mask) | (bits & mask);
+    return i2c_dev_write(dev, reg, &value, 1);
+}
+
+signed char i2c_dev_init(const I2C_DEV *dev, const I2C_REG *table, int count) {
+    unsigned char values[I2C_DEV_BURST];
+    unsigned char len;
+    signed char status;
+    int i = 0;
+
+    while (i < count) {
+        // gather the run of registers that follow on from table[i]
+        len = 0;
+        do {
+            values[len] = table[i + len].value;
+            len++;
+        } while (i + len < count && len < I2C_DEV_BURST
+            && table[i + len].reg == table[i].reg + len);
+        status = i2c_dev_write(dev, table[i].reg, values, len);
+        if (status != I2C_DONE) {
+            return status;
+        }
+        i += len;
+    }
+    return I2C_DONE;
+}
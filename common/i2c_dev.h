@@ -0,0 +1,25 @@
+// register map access to an I2C device through the I2C2 engine: burst reads and writes,
+// read-modify-write, and init sequences from a table. shared by HW6.X and HW7
+
+#ifndef I2C_DEV_H__
+#define I2C_DEV_H__
+
+typedef struct {
+    unsigned char address; // 7 bit slave address
+    unsigned char autoIncrement; // 1 if the register address steps on by itself during a burst
+} I2C_DEV;
+
+typedef struct {
+    unsigned char reg;
+    unsigned char value;
+} I2C_REG;
+
+// these block until the bus is done, and return I2C_DONE or the first error status. the I2C2 engine must be
+// running, and in interrupt mode interrupts must be on
+signed char i2c_dev_write(const I2C_DEV *dev, unsigned char reg, const unsigned char *values, unsigned char len);
+signed char i2c_dev_read(const I2C_DEV *dev, unsigned char reg, unsigned char *values, unsigned char len);
+signed char i2c_dev_update(const I2C_DEV *dev, unsigned char reg, unsigned char mask, unsigned char bits); // set the bits in mask to bits
+// write a table of registers in order, with each run of consecutive registers sent as one burst
+signed char i2c_dev_init(const I2C_DEV *dev, const I2C_REG *table, int count);
+
+#endif
@@ -0,0 +1,359 @@
+// interrupt driven I2C2 master
+// a blocking master spins on SEN, TRSTAT, RBF, ACKEN and PEN for every step of a
+// transfer. the master interrupt flag is set when each of those steps finishes,
+// so here each step is started, and the next one is started from the interrupt (or from
+// i2c_engine_tasks polling the flag) instead of waiting. the CPU is free in between
+//
+// a transaction that has not finished by its deadline on the core timer, or that lost the bus
+// to a collision, is given up on: I2C2 is turned off, SCL is clocked by hand until a slave
+// that was holding SDA low lets go, a STOP is sent, and I2C2 is turned back on. that takes
+// at most about 100 us, and the next transaction in the queue starts after it
+
+#include <xc.h>
+#include <sys/attribs.h>
+#include "i2c_engine.h"
+
+// what the bus is doing, the interrupt comes when it is finished
+#define ST_IDLE    0
+#define ST_START   1
+#define ST_ADDR_W  2
+#define ST_REG     3
+#define ST_TX      4
+#define ST_RESTART 5
+#define ST_ADDR_R  6
+#define ST_RX      7
+#define ST_ACK     8
+#define ST_STOP    9
+
+static I2C_TXN *volatile head = 0; // transaction on the bus
+static I2C_TXN *tail = 0;
+static volatile unsigned char state = ST_IDLE;
+static unsigned char count; // bytes sent or received in ST_TX, ST_RX and ST_ACK
+static signed char result; // status the transaction will finish with after the STOP
+static unsigned char polledMode = 0;
+static unsigned int started; // core timer count when head was started
+static unsigned int allowed; // core timer ticks head has to finish in
+static unsigned long bitTicks = I2C_CORE_TICKS_PER_SEC / I2C_STANDARD; // core timer ticks per bit
+static void (*account)(const I2C_TXN *txn, unsigned int ticks) = 0;
+
+volatile I2C_STATS i2c_engine_stats;
+
+#define I2C_PGD_NS 104 // pulse gobbler delay in the baud rate formula
+#define I2C_SLACK (I2C_CORE_TICKS_PER_SEC / 1000) // 1 ms on top of the bit times for clock stretching
+#define I2C_CLEAR_HALF (I2C_CORE_TICKS_PER_SEC / 200000) // half an SCL period of the bus clear, 100 kHz
+#define I2C_CLEAR_CLOCKS 9 // a slave in the middle of a byte lets go of SDA within 9 clocks
+
+// interrupts are off while the queue changes, so other interrupts (the IMU data ready one)
+// can submit transactions while the engine is being stepped
+static unsigned int i2c_engine_lock(void) {
+    return __builtin_disable_interrupts();
+}
+
+static void i2c_engine_unlock(unsigned int status) {
+    if (status & 1) { // IE was set before
+        __builtin_enable_interrupts();
+    }
+}
+
+// START head and give it twice the time its bits take on the bus
+static void i2c_engine_start(void) {
+    unsigned int bits = 9 * (4 + head->txLen + head->rxLen); // address twice, reg, and a byte of START, RESTART and STOP
+
+    started = _CP0_GET_COUNT();
+    allowed = 2 * bits * bitTicks + I2C_SLACK;
+    I2C2CONbits.SEN = 1;
+    state = ST_START;
+}
+
+// take head off the queue with status and start the next one. head is taken off before the
+// callback so the callback can submit more
+static void i2c_engine_finish(signed char status) {
+    I2C_TXN *txn = head;
+
+    head = txn->next;
+    if (head == 0) {
+        tail = 0;
+    }
+    txn->status = status;
+    if (account) {
+        account(txn, _CP0_GET_COUNT() - started);
+    }
+    if (txn->done) {
+        txn->done(txn);
+    }
+    if (head) {
+        i2c_engine_start();
+    } else {
+        state = ST_IDLE;
+    }
+}
+
+static void i2c_engine_delay(unsigned int ticks) {
+    unsigned int t = _CP0_GET_COUNT();
+
+    while (_CP0_GET_COUNT() - t < ticks) {;}
+}
+
+// bus clear. with I2C2 off, B2 (SDA2) and B3 (SCL2) are plain pins, and they are driven open
+// drain by leaving LAT at 0 and switching TRIS: 0 pulls the line low, 1 lets the pull up have it
+static void i2c_engine_recover(void) {
+    int i;
+
+    i2c_engine_stats.recoveries++;
+    I2C2CONbits.ON = 0;
+    I2C2STATbits.BCL = 0;
+    LATBbits.LATB2 = 0;
+    LATBbits.LATB3 = 0;
+    TRISBbits.TRISB2 = 1;
+    TRISBbits.TRISB3 = 1;
+    for (i = 0; i < I2C_CLEAR_CLOCKS && !PORTBbits.RB2; i++) {
+        TRISBbits.TRISB3 = 0;
+        i2c_engine_delay(I2C_CLEAR_HALF);
+        TRISBbits.TRISB3 = 1;
+        i2c_engine_delay(I2C_CLEAR_HALF);
+    }
+    if (!PORTBbits.RB2) {
+        i2c_engine_stats.stuck++;
+    }
+    // START then STOP with SCL high, so every slave goes back to waiting for a START
+    TRISBbits.TRISB2 = 0;
+    i2c_engine_delay(I2C_CLEAR_HALF);
+    TRISBbits.TRISB2 = 1;
+    i2c_engine_delay(I2C_CLEAR_HALF);
+    I2C2CONbits.ON = 1;
+    IFS1bits.I2C2MIF = 0;
+    IFS1bits.I2C2BIF = 0;
+}
+
+static void i2c_engine_stop(signed char status) {
+    if (status == I2C_NACK) {
+        i2c_engine_stats.nacks++;
+    }
+    result = status;
+    I2C2CONbits.PEN = 1;
+    state = ST_STOP;
+}
+
+// after the write part, either RESTART to read or STOP
+static void i2c_engine_afterWrite(void) {
+    if (head->rxLen) {
+        I2C2CONbits.RSEN = 1;
+        state = ST_RESTART;
+    } else {
+        i2c_engine_stop(I2C_DONE);
+    }
+}
+
+// the step started last has finished, start the next one
+static void i2c_engine_step(void) {
+    I2C_TXN *txn = head;
+
+    if (txn == 0) {
+        state = ST_IDLE;
+        return;
+    }
+
+    if (I2C2STATbits.BCL) { // another master or a glitch on SDA, the module has let go of the bus
+        i2c_engine_stats.collisions++;
+        i2c_engine_recover();
+        i2c_engine_finish(I2C_COLLISION);
+        return;
+    }
+
+    switch (state) {
+        case ST_START:
+            I2C2TRN = txn->address << 1; // write
+            state = ST_ADDR_W;
+            break;
+
+        case ST_ADDR_W:
+            if (I2C2STATbits.ACKSTAT) {
+                i2c_engine_stop(I2C_NACK);
+                break;
+            }
+            I2C2TRN = txn->reg;
+            state = ST_REG;
+            break;
+
+        case ST_REG:
+        case ST_TX:
+            if (I2C2STATbits.ACKSTAT) {
+                i2c_engine_stop(I2C_NACK);
+                break;
+            }
+            if (state == ST_REG) {
+                count = 0;
+            }
+            if (count < txn->txLen) {
+                I2C2TRN = txn->tx[count++];
+                state = ST_TX;
+            } else {
+                i2c_engine_afterWrite();
+            }
+            break;
+
+        case ST_RESTART:
+            I2C2TRN = (txn->address << 1) | 1; // read
+            state = ST_ADDR_R;
+            break;
+
+        case ST_ADDR_R:
+            if (I2C2STATbits.ACKSTAT) {
+                i2c_engine_stop(I2C_NACK);
+                break;
+            }
+            count = 0;
+            I2C2CONbits.RCEN = 1;
+            state = ST_RX;
+            break;
+
+        case ST_RX:
+            txn->rx[count++] = I2C2RCV;
+            I2C2CONbits.ACKDT = count == txn->rxLen; // NACK the last byte
+            I2C2CONbits.ACKEN = 1;
+            state = ST_ACK;
+            break;
+
+        case ST_ACK:
+            if (count < txn->rxLen) {
+                I2C2CONbits.RCEN = 1;
+                state = ST_RX;
+            } else {
+                i2c_engine_stop(I2C_DONE);
+            }
+            break;
+
+        case ST_STOP:
+            i2c_engine_finish(result);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// the master and bus collision events share the I2C2 vector
+void __ISR(_I2C_2_VECTOR, IPL3SOFT) I2C2MasterISR(void) {
+    IFS1bits.I2C2MIF = 0;
+    IFS1bits.I2C2BIF = 0;
+    i2c_engine_step();
+}
+
+void i2c_engine_init(unsigned char polled) {
+    polledMode = polled;
+    head = 0;
+    tail = 0;
+    state = ST_IDLE;
+    IEC1bits.I2C2MIE = 0;
+    IEC1bits.I2C2BIE = 0;
+    IFS1bits.I2C2MIF = 0;
+    IFS1bits.I2C2BIF = 0;
+    IPC9bits.I2C2IP = 3;
+    IEC1bits.I2C2MIE = !polled;
+    IEC1bits.I2C2BIE = !polled;
+}
+
+// I2CxBRG = (1/(2*Fsck) - PGD)*PBCLK - 2, from the I2C chapter of the reference manual.
+// slew rate control is meant for 400 kHz, and is turned off for 100 kHz and 1 MHz
+unsigned long i2c_engine_setSpeed(unsigned long pbclk, unsigned long hz) {
+    long brg;
+    unsigned long halfNs;
+
+    if (hz == 0) {
+        hz = I2C_STANDARD;
+    }
+    brg = (long)(pbclk / (2*hz)) - (long)((pbclk / 1000000 * I2C_PGD_NS + 500) / 1000) - 2;
+    if (brg < 2) { // 0 and 1 are not allowed
+        brg = 2;
+    }
+    if (brg > 0xFFF) {
+        brg = 0xFFF;
+    }
+
+    while (i2c_engine_busy()) { // finish what is on the bus at the old speed
+        i2c_engine_tasks();
+    }
+    I2C2CONbits.ON = 0;
+    I2C2BRG = brg;
+    I2C2CONbits.DISSLW = !(hz > I2C_STANDARD && hz <= I2C_FAST);
+    I2C2CONbits.ON = 1;
+
+    // the same formula backwards gives the speed the bus really runs at
+    halfNs = (unsigned long)(brg + 2) * 1000 / (pbclk / 1000000) + I2C_PGD_NS;
+    hz = 1000000000UL / (2*halfNs);
+    bitTicks = I2C_CORE_TICKS_PER_SEC / hz + 1;
+    return hz;
+}
+
+void i2c_engine_tasks(void) {
+    unsigned int s;
+
+    s = i2c_engine_lock();
+    if (polledMode && (IFS1bits.I2C2MIF || IFS1bits.I2C2BIF)) {
+        IFS1bits.I2C2MIF = 0;
+        IFS1bits.I2C2BIF = 0;
+        i2c_engine_step();
+    }
+    // a stuck bus gives no more interrupts, so the deadline is checked here in both modes
+    if (head && _CP0_GET_COUNT() - started > allowed) {
+        i2c_engine_stats.timeouts++;
+        i2c_engine_recover();
+        i2c_engine_finish(I2C_TIMEOUT);
+    }
+    i2c_engine_unlock(s);
+}
+
+void i2c_engine_submit(I2C_TXN *txn) {
+    unsigned int s;
+
+    txn->status = I2C_PENDING;
+    txn->next = 0;
+
+    s = i2c_engine_lock(); // keep the I2C2 interrupt or the loop from changing the queue while it is added to
+    if (tail) {
+        tail->next = txn;
+        tail = txn;
+    } else {
+        head = txn;
+        tail = txn;
+        i2c_engine_start(); // the bus is idle, start now
+    }
+    i2c_engine_unlock(s);
+}
+
+void i2c_engine_read(I2C_TXN *txn, unsigned char address, unsigned char reg, unsigned char *rx, unsigned char len, void (*done)(I2C_TXN *)) {
+    txn->address = address;
+    txn->reg = reg;
+    txn->tx = 0;
+    txn->txLen = 0;
+    txn->rx = rx;
+    txn->rxLen = len;
+    txn->done = done;
+    i2c_engine_submit(txn);
+}
+
+void i2c_engine_write(I2C_TXN *txn, unsigned char address, unsigned char reg, const unsigned char *tx, unsigned char len, void (*done)(I2C_TXN *)) {
+    txn->address = address;
+    txn->reg = reg;
+    txn->tx = tx;
+    txn->txLen = len;
+    txn->rx = 0;
+    txn->rxLen = 0;
+    txn->done = done;
+    i2c_engine_submit(txn);
+}
+
+void i2c_engine_setAccount(void (*fn)(const I2C_TXN *txn, unsigned int ticks)) {
+    account = fn;
+}
+
+int i2c_engine_busy(void) {
+    return head != 0;
+}
+
+signed char i2c_engine_wait(I2C_TXN *txn) {
+    while (txn->status == I2C_PENDING) {
+        i2c_engine_tasks();
+    }
+    return txn->status;
+}
@@ -0,0 +1,64 @@
+// interrupt driven I2C2 master that works through a queue of register transactions
+// shared by HW6.X and HW7
+
+#ifndef I2C_ENGINE_H__
+#define I2C_ENGINE_H__
+
+#define I2C_DONE 0 // transaction status values
+#define I2C_PENDING 1 // queued or on the bus
+#define I2C_NACK -1 // the slave did not acknowledge its address or a byte
+#define I2C_COLLISION -2 // lost the bus (BCL), the bus was cleared
+#define I2C_TIMEOUT -3 // not finished in time, the bus was cleared
+
+#define I2C_CORE_TICKS_PER_SEC 24000000 // core timer, half the 48 MHz SYSCLK, for the timeouts
+
+#define I2C_STANDARD 100000 // bus speeds for i2c_engine_setSpeed, in Hz
+#define I2C_FAST 400000
+#define I2C_FAST_PLUS 1000000
+
+typedef struct I2C_TXN I2C_TXN;
+
+// one transaction: START, address, reg, the tx bytes, then if there are rx bytes a
+// RESTART, address, and the rx bytes, then STOP. the caller owns the struct and the
+// buffers, and they must stay valid until status is no longer I2C_PENDING
+struct I2C_TXN {
+    unsigned char address; // 7 bit slave address
+    unsigned char reg; // first register
+    const unsigned char *tx; // bytes written after reg, can be 0 when txLen is 0
+    unsigned char txLen;
+    unsigned char *rx; // bytes read back, can be 0 when rxLen is 0
+    unsigned char rxLen;
+    void (*done)(I2C_TXN *); // called when the STOP has gone out, from the interrupt in interrupt mode, can be 0
+    volatile signed char status;
+    I2C_TXN *next; // used by the queue
+};
+
+// counted since reset, for diagnostics
+typedef struct {
+    unsigned long nacks;
+    unsigned long collisions;
+    unsigned long timeouts;
+    unsigned long recoveries; // bus clears, one for each collision and timeout
+    unsigned long stuck; // bus clears that ended with SDA still low
+} I2C_STATS;
+
+extern volatile I2C_STATS i2c_engine_stats;
+
+// polled 1 runs the state machine from i2c_engine_tasks instead of the I2C2 master interrupt,
+// for main loops like Harmony's. I2C2 must already be set up
+void i2c_engine_init(unsigned char polled);
+unsigned long i2c_engine_setSpeed(unsigned long pbclk, unsigned long hz); // set I2C2BRG and slew control and turn I2C2 on, returns the real speed in Hz
+// call from the main loop. in polled mode it runs the state machine, and in both modes it
+// gives up on a transaction that is past its deadline, which is twice its bit times plus 1 ms
+void i2c_engine_tasks(void);
+void i2c_engine_submit(I2C_TXN *txn); // add a filled in transaction to the queue, can be called from an interrupt
+void i2c_engine_read(I2C_TXN *txn, unsigned char address, unsigned char reg, unsigned char *rx, unsigned char len, void (*done)(I2C_TXN *));
+void i2c_engine_write(I2C_TXN *txn, unsigned char address, unsigned char reg, const unsigned char *tx, unsigned char len, void (*done)(I2C_TXN *));
+// account is called for every transaction as it finishes, whoever submitted it, with its status
+// set and before its done, with the core timer ticks from its START to its STOP (or to the end
+// of the bus clear when it was given up on). from the interrupt in interrupt mode, 0 for none
+void i2c_engine_setAccount(void (*account)(const I2C_TXN *txn, unsigned int ticks));
+int i2c_engine_busy(void); // 1 while anything is queued
+signed char i2c_engine_wait(I2C_TXN *txn); // block until txn is finished or has timed out and return its status
+
+#endif
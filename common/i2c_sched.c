@@ -0,0 +1,278 @@
+// I2C2 bus scheduler
+// only one transaction of the scheduler is with the engine at a time, so which job goes next
+// is decided each time the bus comes free rather than when jobs are added. the next one is
+// started from the last one's callback, and from i2c_sched_tasks when the bus was idle.
+// a read that is due picks up the other due reads on the same device whose registers touch or
+// overlap its own, and they are read as one burst into a buffer and copied out. latency is
+// counted from when a job was due, so it includes the wait behind other jobs and devices.
+// transactions submitted to the engine directly (the IMU data ready reads) still go in
+// between, in the order they were submitted. the bus time is not taken from when a job was
+// submitted, which would count the wait behind those too, but from the engine's accounting,
+// which times every transaction from its START to its STOP and finds its device by address
+
+#include <xc.h>
+#include <string.h>
+#include "i2c_engine.h"
+#include "i2c_sched.h"
+
+static I2C_JOB *jobs = 0;
+static I2C_SCHED_DEV *devices = 0;
+static I2C_TXN txn;
+static I2C_JOB *burst[I2C_SCHED_MERGE]; // jobs in txn
+static unsigned char burstJobs;
+static unsigned char burstReg; // first register of a merged read
+static unsigned char buffer[I2C_SCHED_BURST];
+static volatile unsigned char onBus = 0;
+static unsigned int windowStart;
+static unsigned long busTicks; // every transaction
+
+// the list and the burst are changed from the I2C2 interrupt too
+static unsigned int i2c_sched_lock(void) {
+    return __builtin_disable_interrupts();
+}
+
+static void i2c_sched_unlock(unsigned int status) {
+    if (status & 1) {
+        __builtin_enable_interrupts();
+    }
+}
+
+static int i2c_sched_isDue(const I2C_JOB *j, unsigned int now) {
+    return (int)(now - j->due) >= 0;
+}
+
+static int i2c_sched_inBurst(const I2C_JOB *j) {
+    int i;
+
+    for (i = 0; i < burstJobs; i++) {
+        if (burst[i] == j) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void i2c_sched_unlink(I2C_JOB *job) {
+    I2C_JOB **p = &jobs;
+
+    while (*p && *p != job) {
+        p = &(*p)->next;
+    }
+    if (*p) {
+        *p = job->next;
+    }
+    job->queued = 0;
+}
+
+// the due job of the highest priority device, the one due longest ago if there are several
+static I2C_JOB *i2c_sched_pick(unsigned int now) {
+    I2C_JOB *j, *best = 0;
+
+    for (j = jobs; j; j = j->next) {
+        if (!i2c_sched_isDue(j, now)) {
+            continue;
+        }
+        if (best == 0 || j->dev->priority < best->dev->priority
+            || (j->dev->priority == best->dev->priority && (int)(j->due - best->due) < 0)) {
+            best = j;
+        }
+    }
+    return best;
+}
+
+// add the due reads of first's device that touch the registers already in the burst, until
+// nothing more fits, and return how many bytes the burst reads
+static unsigned char i2c_sched_merge(unsigned int now) {
+    I2C_JOB *j, *first = burst[0];
+    int lo = first->reg, hi = first->reg + first->len, newLo, newHi, grown;
+
+    do {
+        grown = 0;
+        for (j = jobs; j && burstJobs < I2C_SCHED_MERGE; j = j->next) {
+            if (j->dev != first->dev || j->tx || !i2c_sched_isDue(j, now) || i2c_sched_inBurst(j)) {
+                continue;
+            }
+            if (j->reg > hi || j->reg + j->len < lo) {
+                continue;
+            }
+            newLo = j->reg < lo ? j->reg : lo;
+            newHi = j->reg + j->len > hi ? j->reg + j->len : hi;
+            if (newHi - newLo > I2C_SCHED_BURST) {
+                continue;
+            }
+            burst[burstJobs++] = j;
+            lo = newLo;
+            hi = newHi;
+            grown = 1;
+        }
+    } while (grown);
+    burstReg = lo;
+    return hi - lo;
+}
+
+static void i2c_sched_done(I2C_TXN *t);
+
+// the engine's accounting, called for every transaction as it finishes
+static void i2c_sched_account(const I2C_TXN *t, unsigned int ticks) {
+    I2C_SCHED_DEV *dev;
+
+    busTicks += ticks;
+    for (dev = devices; dev; dev = dev->next) {
+        if (dev->address == t->address) {
+            dev->busTicks += ticks;
+            dev->transactions++;
+            if (t->status != I2C_DONE) {
+                dev->errors++;
+            }
+            return;
+        }
+    }
+}
+
+// called with the lock held and the bus free
+static void i2c_sched_start(unsigned int now) {
+    I2C_JOB *j = i2c_sched_pick(now);
+    unsigned char len = 0;
+
+    if (j == 0) {
+        return;
+    }
+    burst[0] = j;
+    burstJobs = 1;
+    onBus = 1;
+    if (j->tx) {
+        i2c_engine_write(&txn, j->dev->address, j->reg, j->tx, j->len, i2c_sched_done);
+        return;
+    }
+    if (j->dev->autoIncrement) {
+        len = i2c_sched_merge(now);
+    }
+    if (burstJobs == 1) {
+        i2c_engine_read(&txn, j->dev->address, j->reg, j->rx, j->len, i2c_sched_done);
+    } else {
+        i2c_engine_read(&txn, j->dev->address, burstReg, buffer, len, i2c_sched_done);
+    }
+}
+
+static void i2c_sched_done(I2C_TXN *t) {
+    unsigned int now = _CP0_GET_COUNT(), latency;
+    I2C_SCHED_DEV *dev = burst[0]->dev;
+    I2C_JOB *j;
+    int i;
+
+    for (i = 0; i < burstJobs; i++) {
+        j = burst[i];
+        if (burstJobs > 1 && t->status == I2C_DONE) {
+            memcpy(j->rx, &buffer[j->reg - burstReg], j->len);
+        }
+        latency = now - j->due;
+        if (latency > dev->worstLatency) {
+            dev->worstLatency = latency;
+        }
+        if (j->period) {
+            // a job that has fallen a whole period behind skips the runs it missed
+            j->due += j->period;
+            if ((int)(now - j->due) > 0) {
+                j->due = now;
+            }
+        } else {
+            i2c_sched_unlink(j);
+        }
+        j->status = t->status;
+        if (j->done) {
+            j->done(j);
+        }
+    }
+    burstJobs = 0;
+    onBus = 0;
+    i2c_sched_start(now);
+}
+
+void i2c_sched_init(void) {
+    jobs = 0;
+    devices = 0;
+    burstJobs = 0;
+    onBus = 0;
+    i2c_sched_clearStats();
+    i2c_engine_setAccount(i2c_sched_account);
+}
+
+void i2c_sched_addDevice(I2C_SCHED_DEV *dev) {
+    I2C_SCHED_DEV *d;
+    unsigned int s;
+
+    s = i2c_sched_lock();
+    for (d = devices; d && d != dev; d = d->next) {;}
+    if (d == 0) {
+        dev->busTicks = 0;
+        dev->worstLatency = 0;
+        dev->transactions = 0;
+        dev->errors = 0;
+        dev->next = devices;
+        devices = dev;
+    }
+    i2c_sched_unlock(s);
+}
+
+void i2c_sched_add(I2C_JOB *job) {
+    unsigned int s;
+
+    i2c_sched_addDevice(job->dev);
+    job->status = I2C_PENDING;
+    job->due = _CP0_GET_COUNT();
+    s = i2c_sched_lock();
+    if (!job->queued) {
+        job->queued = 1;
+        job->next = jobs;
+        jobs = job;
+    }
+    i2c_sched_unlock(s);
+}
+
+void i2c_sched_remove(I2C_JOB *job) {
+    unsigned int s;
+
+    s = i2c_sched_lock();
+    i2c_sched_unlink(job);
+    i2c_sched_unlock(s);
+    while (onBus && i2c_sched_inBurst(job)) {
+        i2c_engine_tasks();
+    }
+}
+
+void i2c_sched_tasks(void) {
+    unsigned int s;
+
+    s = i2c_sched_lock();
+    if (!onBus) {
+        i2c_sched_start(_CP0_GET_COUNT());
+    }
+    i2c_sched_unlock(s);
+}
+
+void i2c_sched_clearStats(void) {
+    I2C_SCHED_DEV *d;
+    unsigned int s;
+
+    s = i2c_sched_lock();
+    for (d = devices; d; d = d->next) {
+        d->busTicks = 0;
+        d->worstLatency = 0;
+        d->transactions = 0;
+        d->errors = 0;
+    }
+    busTicks = 0;
+    windowStart = _CP0_GET_COUNT();
+    i2c_sched_unlock(s);
+}
+
+// the core timer wraps after 178 s, so clear the stats more often than that
+unsigned int i2c_sched_utilization(const I2C_SCHED_DEV *dev) {
+    unsigned int window = _CP0_GET_COUNT() - windowStart;
+    unsigned long ticks = dev ? dev->busTicks : busTicks;
+
+    if (window == 0) {
+        return 0;
+    }
+    return (unsigned int)((unsigned long long)ticks * 1000 / window);
+}
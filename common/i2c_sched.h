@@ -0,0 +1,62 @@
+// I2C2 bus scheduler for several devices: periodic and one shot register jobs run in order of
+// device priority, and reads of neighbouring registers on the same device share one burst.
+// each device keeps how much of the bus it used and the longest a job of it waited. the bus
+// time is counted by the engine for every transaction, so a device's reads that are submitted
+// to the engine directly count too once the device is added. shared by HW6.X and HW7
+
+#ifndef I2C_SCHED_H__
+#define I2C_SCHED_H__
+
+#define I2C_SCHED_BURST 32 // most bytes read in one merged burst
+#define I2C_SCHED_MERGE 8 // most jobs that share one burst
+
+typedef struct I2C_SCHED_DEV I2C_SCHED_DEV;
+
+struct I2C_SCHED_DEV {
+    unsigned char address; // 7 bit slave address
+    unsigned char autoIncrement; // 1 if the register address steps on by itself, needed to merge reads
+    unsigned char priority; // 0 goes first, then 1, ...
+    // counted since i2c_sched_clearStats, in core timer ticks
+    unsigned long busTicks; // from the START of its transactions to the STOP
+    unsigned int worstLatency; // from a job being due to it being done
+    unsigned long transactions; // all of them, not only the jobs'
+    unsigned long errors;
+    I2C_SCHED_DEV *next; // used by the scheduler
+};
+
+typedef struct I2C_JOB I2C_JOB;
+
+// one register read (tx 0) or write (rx 0) on a device. the caller owns the struct and the
+// buffers, and they must stay valid while the job is added. queued must be 0 before the
+// first i2c_sched_add, as it is in a static
+struct I2C_JOB {
+    I2C_SCHED_DEV *dev;
+    unsigned char reg;
+    const unsigned char *tx;
+    unsigned char *rx;
+    unsigned char len;
+    unsigned int period; // core timer ticks between runs, 0 runs once and then the job is taken out
+    void (*done)(I2C_JOB *); // called when the job's transaction is done, from the I2C2 interrupt in interrupt mode, can be 0
+    volatile signed char status; // I2C_PENDING until the first run is done, then that run's status
+    // used by the scheduler
+    unsigned int due; // core timer count of the next run
+    unsigned char queued; // still in the list
+    I2C_JOB *next;
+};
+
+void i2c_sched_init(void); // the I2C2 engine must be running, this takes its accounting
+// count a device's bus time, transactions and errors, the ones it does not make through jobs
+// too. a job's device is added by i2c_sched_add
+void i2c_sched_addDevice(I2C_SCHED_DEV *dev);
+// add a job, due now. a periodic job stays until i2c_sched_remove, a one shot one is taken out after it runs
+void i2c_sched_add(I2C_JOB *job);
+void i2c_sched_remove(I2C_JOB *job); // waits if it is on the bus
+// call from the main loop. starts the most urgent due job, with the reads it can be merged with, when the bus is free
+void i2c_sched_tasks(void);
+
+void i2c_sched_clearStats(void); // zero every device's counters and start a new utilization window
+// bus time used since i2c_sched_clearStats, in tenths of a percent, by one device, or with 0 by
+// every transaction on the bus, added devices or not
+unsigned int i2c_sched_utilization(const I2C_SCHED_DEV *dev);
+
+#endif
@@ -0,0 +1,343 @@
+// LSM6DS33 on-chip FIFO
+// the sensor keeps up to 4096 words of samples itself. a drain reads FIFO_STATUS1-4 to get how
+// many words are waiting and where in the gyro, accel pattern the next one is, then reads the
+// words from FIFO_DATA_OUT in a single burst (the address wraps from FIFO_DATA_OUT_H back to
+// FIFO_DATA_OUT_L, AN4650), and both reads are chained from the I2C2 engine's callbacks.
+// a drain is started by the watermark on INT1, so the bus only carries reads when there is a
+// batch to take
+
+#include <xc.h>
+#include <sys/attribs.h>
+#include "i2c_engine.h"
+#include "i2c_dev.h"
+#include "ring.h"
+#include "lsm6ds33.h"
+
+#define FIFO_CTRL1 0x06 // watermark bits 7:0
+#define FIFO_CTRL2 0x07 // watermark bits 11:8
+#define FIFO_CTRL3 0x08 // gyro decimation 5:3, accel decimation 2:0
+#define FIFO_CTRL4 0x09
+#define FIFO_CTRL5 0x0A // FIFO ODR 6:3, mode 2:0
+#define DRDY_PULSE_CFG_G 0x0B
+#define INT1_CTRL  0x0D
+#define TAP_SRC    0x1C
+#define FIFO_STATUS1 0x3A
+#define FIFO_DATA_OUT_L 0x3E
+#define TAP_CFG    0x58
+#define TAP_THS_6D 0x59
+#define INT_DUR2   0x5A
+#define WAKE_UP_THS 0x5B
+
+#define FIFO_MODE_BYPASS 0
+#define FIFO_MODE_CONTINUOUS 6
+#define INT1_FTH 0x08 // watermark on INT1
+#define DRDY_PULSED 0x80 // 75 us data ready pulses instead of holding INT1 until the data is read
+
+#define STATUS2_WATERMARK 0x80
+#define STATUS2_OVERRUN 0x40
+
+// drain states
+#define DRAIN_IDLE   0
+#define DRAIN_STATUS 1 // reading FIFO_STATUS1-4
+#define DRAIN_DATA   2 // reading the words
+#define DRAIN_READY  3 // samples waiting for lsm6_fifoSamples
+
+unsigned long lsm6_fifoOverruns = 0;
+
+static I2C_TXN txn;
+static unsigned char status[4];
+static unsigned char data[LSM6_BATCH * 12];
+static LSM6_SAMPLE samples[LSM6_BATCH];
+static volatile unsigned char drainState = DRAIN_IDLE;
+static unsigned char sampleCount, sampleNext;
+static unsigned char hasAccel, hasGyro, setWords; // words per sample in the FIFO
+static unsigned short pattern; // position in the sample of the first word being read
+static volatile unsigned short level;
+
+// what INT1 is set up for, both come in on the INT2 interrupt
+#define INT1_OFF  0
+#define INT1_FIFO 1
+#define INT1_DRDY 2
+static unsigned char int1Mode = INT1_OFF;
+
+static void lsm6_drainStart(void);
+
+// decimation factor to the FIFO_CTRL3 code, 0 leaves the sensor out
+static unsigned char lsm6_decimation(unsigned char n) {
+    switch (n) {
+        case 0: return 0;
+        case 1: return 1;
+        case 2: return 2;
+        case 3: return 3;
+        case 4: return 4;
+        case 8: return 5;
+        case 16: return 6;
+        default: return 7; // 32
+    }
+}
+
+static const I2C_DEV lsm6 = {LSM6_ADDRESS, 1};
+
+static void lsm6_write(unsigned char reg, unsigned char value) {
+    i2c_dev_write(&lsm6, reg, &value, 1);
+}
+
+// INT1 is wired to B13, which is INT2 through PPS. the interrupt is left off
+static void lsm6_int1Pin(void) {
+    IEC0bits.INT2IE = 0;
+    ANSELBbits.ANSB13 = 0;
+    TRISBbits.TRISB13 = 1;
+    INT2Rbits.INT2R = 0b0011; // B13 is INT2
+    INTCONbits.INT2EP = 1; // rising edge
+    IPC2bits.INT2IP = 2; // below the I2C2 interrupt
+    IFS0bits.INT2IF = 0;
+}
+
+void lsm6_fifoInit(unsigned char odr, unsigned char decimateAccel, unsigned char decimateGyro, unsigned short watermark) {
+    lsm6_fifoStop();
+    hasAccel = decimateAccel != 0;
+    hasGyro = decimateGyro != 0;
+    if (hasAccel && hasGyro) {
+        decimateGyro = decimateAccel; // keeps the pattern a plain gyro, accel repeat
+    }
+    setWords = 3 * (hasAccel + hasGyro);
+    if (watermark > 4095) {
+        watermark = 4095;
+    }
+    lsm6_write(FIFO_CTRL1, watermark & 0xFF);
+    lsm6_write(FIFO_CTRL2, watermark >> 8);
+    lsm6_write(FIFO_CTRL3, (lsm6_decimation(decimateGyro) << 3) | lsm6_decimation(decimateAccel));
+    lsm6_write(FIFO_CTRL4, 0);
+    lsm6_int1Pin();
+    lsm6_write(INT1_CTRL, INT1_FTH);
+    lsm6_write(FIFO_CTRL5, ((odr & 0x0F) << 3) | FIFO_MODE_CONTINUOUS);
+    int1Mode = INT1_FIFO;
+    IEC0bits.INT2IE = 1;
+    if (PORTBbits.RB13) { // reached the watermark before the edge could be seen
+        lsm6_drainStart();
+    }
+}
+
+void lsm6_fifoStop(void) {
+    IEC0bits.INT2IE = 0;
+    while (drainState == DRAIN_STATUS || drainState == DRAIN_DATA) {
+        i2c_engine_tasks();
+    }
+    if (int1Mode == INT1_FIFO) {
+        lsm6_write(INT1_CTRL, 0);
+        int1Mode = INT1_OFF;
+    }
+    lsm6_write(FIFO_CTRL5, FIFO_MODE_BYPASS);
+    drainState = DRAIN_IDLE;
+}
+
+// sort the words that came in into samples, a sample that was cut off at the start is dropped
+static void lsm6_parse(unsigned char words) {
+    LSM6_SAMPLE *s = &samples[0];
+    unsigned char i, slot = pattern;
+    unsigned char whole = pattern == 0; // the first sample is complete
+    short w;
+
+    sampleCount = 0;
+    for (i = 0; i < words; i++) {
+        w = data[2*i] | (data[2*i+1] << 8);
+        // the gyro comes first when both sensors are in the FIFO
+        if (hasGyro && slot < 3) {
+            s->gyro[slot] = w;
+        } else {
+            s->accel[slot - 3*hasGyro] = w;
+        }
+        if (++slot == setWords) {
+            slot = 0;
+            if (!hasGyro) {
+                s->gyro[0] = s->gyro[1] = s->gyro[2] = 0;
+            }
+            if (!hasAccel) {
+                s->accel[0] = s->accel[1] = s->accel[2] = 0;
+            }
+            if (whole) {
+                sampleCount++;
+                s = &samples[sampleCount];
+            }
+            whole = 1;
+        }
+    }
+}
+
+// the last drain is done with. INT1 stays high while the FIFO is at the watermark and only an
+// edge interrupts, so one that is still full enough is drained again now. the interrupt is held
+// off so it cannot start a drain between the two
+static void lsm6_drainNext(void) {
+    unsigned char ie = IEC0bits.INT2IE;
+
+    IEC0bits.INT2IE = 0;
+    drainState = DRAIN_IDLE;
+    if (int1Mode == INT1_FIFO && PORTBbits.RB13) {
+        lsm6_drainStart();
+    }
+    IEC0bits.INT2IE = ie;
+}
+
+static void lsm6_drainDone(I2C_TXN *t) {
+    unsigned short words;
+
+    if (t->status != I2C_DONE) {
+        lsm6_drainNext();
+        return;
+    }
+
+    if (drainState == DRAIN_STATUS) {
+        level = status[0] | ((status[1] & 0x0F) << 8);
+        pattern = setWords ? (status[2] | ((status[3] & 0x03) << 8)) % setWords : 0;
+        if (status[1] & STATUS2_OVERRUN) {
+            lsm6_fifoOverruns++;
+        }
+        if (!(status[1] & STATUS2_WATERMARK) || setWords == 0) {
+            lsm6_drainNext();
+            return;
+        }
+        // read up to the end of a whole sample
+        words = level;
+        if (words > LSM6_BATCH * setWords) {
+            words = LSM6_BATCH * setWords;
+        }
+        words = (pattern + words) / setWords * setWords;
+        if (words <= pattern) {
+            lsm6_drainNext();
+            return;
+        }
+        words -= pattern;
+        drainState = DRAIN_DATA;
+        i2c_engine_read(&txn, LSM6_ADDRESS, FIFO_DATA_OUT_L, data, 2*words, lsm6_drainDone);
+    } else if (drainState == DRAIN_DATA) {
+        lsm6_parse(t->rxLen / 2);
+        sampleNext = 0;
+        if (sampleCount) {
+            drainState = DRAIN_READY; // the next drain waits until these are taken
+        } else {
+            lsm6_drainNext();
+        }
+    }
+}
+
+// from the INT2 interrupt, or with it held off
+static void lsm6_drainStart(void) {
+    if (drainState != DRAIN_IDLE) {
+        return;
+    }
+    drainState = DRAIN_STATUS;
+    i2c_engine_read(&txn, LSM6_ADDRESS, FIFO_STATUS1, status, 4, lsm6_drainDone);
+}
+
+int lsm6_fifoSamples(LSM6_SAMPLE *out, int max) {
+    int n = 0;
+
+    if (drainState != DRAIN_READY) {
+        return 0;
+    }
+    while (n < max && sampleNext < sampleCount) {
+        out[n++] = samples[sampleNext++];
+    }
+    if (sampleNext == sampleCount) {
+        lsm6_drainNext();
+    }
+    return n;
+}
+
+unsigned short lsm6_fifoLevel(void) {
+    return level;
+}
+
+// data ready
+// the read for a pulse is started from the interrupt, and its callback puts the reading in a
+// ring that the main loop takes them out of. a pulse that comes while the last read is still on
+// the bus is counted and skipped. the read starts 4 registers early at TAP_SRC, so tap events
+// come in with every reading without a transaction of their own
+
+unsigned long lsm6_drdyMissed = 0;
+unsigned long lsm6_drdyOverflows = 0;
+
+static I2C_TXN drdyTxn;
+static unsigned char drdyData[18]; // TAP_SRC, D6D_SRC, STATUS_REG, a reserved register, then OUT_TEMP_L on
+static volatile unsigned char drdyReading = 0; // drdyTxn is on the bus
+static unsigned int drdyTime; // stamp of the pulse drdyTxn is reading
+static LSM6_READING readings[LSM6_DRDY_RING];
+static RING ring;
+
+static void lsm6_drdyDone(I2C_TXN *t) {
+    LSM6_READING r;
+    int i;
+
+    drdyReading = 0;
+    if (t->status != I2C_DONE) {
+        return;
+    }
+    r.time = drdyTime;
+    r.tap = drdyData[0];
+    r.temp = drdyData[4] | (drdyData[5] << 8);
+    for (i = 0; i < 3; i++) {
+        r.gyro[i] = drdyData[6+2*i] | (drdyData[7+2*i] << 8);
+        r.accel[i] = drdyData[12+2*i] | (drdyData[13+2*i] << 8);
+    }
+    if (!ring_put(&ring, &r)) {
+        lsm6_drdyOverflows++;
+    }
+}
+
+// INT1, the FIFO watermark or a data ready pulse
+void __ISR(_EXTERNAL_2_VECTOR, IPL2SOFT) IMUInt1ISR(void) {
+    unsigned int now = _CP0_GET_COUNT();
+
+    IFS0bits.INT2IF = 0;
+    if (int1Mode == INT1_FIFO) {
+        lsm6_drainStart();
+        return;
+    }
+    if (drdyReading) {
+        lsm6_drdyMissed++;
+        return;
+    }
+    drdyReading = 1;
+    drdyTime = now;
+    i2c_engine_read(&drdyTxn, LSM6_ADDRESS, TAP_SRC, drdyData, 18, lsm6_drdyDone);
+}
+
+void lsm6_drdyInit(unsigned char sources) {
+    lsm6_int1Pin();
+    lsm6_write(DRDY_PULSE_CFG_G, DRDY_PULSED);
+    lsm6_write(INT1_CTRL, sources & (LSM6_DRDY_XL | LSM6_DRDY_G));
+    drdyReading = 0;
+    ring_init(&ring, readings, sizeof(LSM6_READING), LSM6_DRDY_RING);
+    int1Mode = INT1_DRDY;
+    IFS0bits.INT2IF = 0;
+    IEC0bits.INT2IE = 1;
+}
+
+void lsm6_drdyStop(void) {
+    IEC0bits.INT2IE = 0;
+    if (drdyReading) {
+        i2c_engine_wait(&drdyTxn);
+    }
+    lsm6_write(INT1_CTRL, 0);
+    int1Mode = INT1_OFF;
+}
+
+int lsm6_drdyRead(LSM6_READING *out) {
+    return ring_get(&ring, out);
+}
+
+// tap detection
+// the thresholds and windows follow the double tap example in AN4682, with the windows as long
+// as they go at 1.66 kHz: 14 ms of shock, 7 ms of quiet and 289 ms between the taps. the
+// interrupt is latched so each tap shows in TAP_SRC until one reading has taken it, and it is
+// not put on INT1, which a latched level would hold high over the data ready pulses
+static const I2C_REG tapInit[] = {
+    {TAP_CFG, 0x0F}, // X, Y and Z taps, latched
+    {TAP_THS_6D, 0x0C}, // 12 * FS/32, 0.75 g at 2 g full scale
+    {INT_DUR2, 0xFF}, // DUR 15, QUIET 3, SHOCK 3
+    {WAKE_UP_THS, 0x80}, // single and double taps
+};
+
+void lsm6_tapInit(void) {
+    i2c_dev_init(&lsm6, tapInit, sizeof(tapInit)/sizeof(tapInit[0]));
+}
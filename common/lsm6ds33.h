@@ -0,0 +1,73 @@
+// LSM6DS33 on-chip FIFO, drained in long I2C bursts, and data ready sampling, both read in the
+// background by the I2C2 engine
+// shared by HW6.X and HW7
+
+#ifndef LSM6DS33_H__
+#define LSM6DS33_H__
+
+#define LSM6_ADDRESS 0b1101011
+
+// FIFO_ODR codes for lsm6_fifoInit, must not be faster than the sensors run in CTRL1_XL/CTRL2_G
+#define LSM6_ODR_12_5 1
+#define LSM6_ODR_26   2
+#define LSM6_ODR_52   3
+#define LSM6_ODR_104  4
+#define LSM6_ODR_208  5
+#define LSM6_ODR_416  6
+#define LSM6_ODR_833  7
+#define LSM6_ODR_1660 8
+#define LSM6_ODR_3330 9
+#define LSM6_ODR_6660 10
+
+#define LSM6_BATCH 21 // most samples taken in one drain, 21 gyro + accel sets is 252 bytes, what an I2C_TXN can read
+
+typedef struct {
+    short gyro[3]; // x y z, 0 when the gyro is not in the FIFO
+    short accel[3]; // x y z, 0 when the accelerometer is not in the FIFO
+} LSM6_SAMPLE;
+
+extern unsigned long lsm6_fifoOverruns; // drains that found the FIFO had filled up and lost samples
+
+// put the sensors in the FIFO in continuous mode at odr. decimation is 1, 2, 3, 4, 8, 16 or 32 samples
+// per FIFO entry for each sensor, 0 leaves it out, and when both are in the gyro uses the accel's. the watermark, in 16 bit words, goes
+// to INT1 on B13, and each time the FIFO reaches it the INT2 interrupt starts a drain in the background: the FIFO status is
+// read, then up to LSM6_BATCH whole samples in one burst. blocks until the registers are written, the I2C2 engine must be running
+void lsm6_fifoInit(unsigned char odr, unsigned char decimateAccel, unsigned char decimateGyro, unsigned short watermark);
+void lsm6_fifoStop(void); // back to bypass mode, the FIFO is emptied
+
+// copy out the samples of a finished drain, 0 if there are none yet. the next drain waits until
+// they have all been taken
+int lsm6_fifoSamples(LSM6_SAMPLE *out, int max);
+unsigned short lsm6_fifoLevel(void); // words that were in the FIFO at the last status read
+
+// data ready sampling. INT1 is wired to B13, which is INT2 through PPS. each data ready pulse is
+// stamped with the core timer and starts a read of the tap status, temperature, gyro and accel
+// from the INT2 interrupt. INT1 also carries the FIFO watermark, so use this or the FIFO, not both
+#define LSM6_DRDY_XL 0x01 // which conversions pulse INT1, for lsm6_drdyInit
+#define LSM6_DRDY_G  0x02
+#define LSM6_DRDY_RING 16 // readings kept until they are read, a power of two
+
+typedef struct {
+    unsigned int time; // core timer count at the data ready pulse
+    unsigned char tap; // TAP_SRC, LSM6_TAP_ bits, 0 until lsm6_tapInit
+    short temp;
+    short gyro[3]; // x y z
+    short accel[3]; // x y z
+} LSM6_READING;
+
+extern unsigned long lsm6_drdyMissed; // pulses that came while the last read was still on the bus
+extern unsigned long lsm6_drdyOverflows; // readings lost because the ring was full
+
+// blocks until INT1 is set up, the I2C2 engine must be running
+void lsm6_drdyInit(unsigned char sources);
+void lsm6_drdyStop(void);
+int lsm6_drdyRead(LSM6_READING *out); // 1 with the oldest reading not read yet, 0 if there are none
+
+// tap detection, reported in the tap of each data ready reading. the accelerometer must run at
+// 1.66 kHz for the tap windows to be as long as they are set for. blocks like lsm6_drdyInit
+#define LSM6_TAP_IA     0x40 // a tap happened
+#define LSM6_TAP_SINGLE 0x20
+#define LSM6_TAP_DOUBLE 0x10
+void lsm6_tapInit(void);
+
+#endif
@@ -0,0 +1,70 @@
+// integer and fixed-point to decimal text, without printf
+// floats are scaled to integers first (e.g. hundredths for two decimals), so
+// formatting costs a few divides by 10 instead of the soft-float printf machinery
+
+#include "numfmt.h"
+
+// the magnitude v with its sign, 0 for none
+static int fmt_digits(char *buf, unsigned long v, char sign, unsigned char decimals, unsigned char width, unsigned char flags) {
+    char digits[FMT_MAX];
+    int n = 0, len, pad, i;
+
+    if (decimals > 9) {
+        decimals = 9;
+    }
+
+    // digits come out backwards, fraction first, with at least one integer digit
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+        if (decimals && n == decimals) {
+            digits[n++] = '.';
+            if (v == 0) {
+                digits[n++] = '0';
+            }
+        }
+    } while (v != 0 || n <= decimals);
+
+    len = n + (sign != 0);
+    pad = width > len ? width - len : 0;
+    i = 0;
+    if (!(flags & (FMT_LEFT | FMT_ZERO))) {
+        while (pad) {
+            buf[i++] = ' ';
+            pad--;
+        }
+    }
+    if (sign) {
+        buf[i++] = sign;
+    }
+    if (flags & FMT_ZERO && !(flags & FMT_LEFT)) {
+        while (pad) {
+            buf[i++] = '0';
+            pad--;
+        }
+    }
+    while (n) {
+        buf[i++] = digits[--n];
+    }
+    while (pad) {
+        buf[i++] = ' ';
+        pad--;
+    }
+    buf[i] = 0;
+    return i;
+}
+
+int fmt_fixed(char *buf, long value, unsigned char decimals, unsigned char width, unsigned char flags) {
+    unsigned long v = value < 0 ? -(unsigned long)value : (unsigned long)value;
+    char sign = value < 0 ? '-' : ((flags & FMT_PLUS) ? '+' : 0);
+
+    return fmt_digits(buf, v, sign, decimals, width, flags);
+}
+
+int fmt_int(char *buf, long value, unsigned char width, unsigned char flags) {
+    return fmt_fixed(buf, value, 0, width, flags);
+}
+
+int fmt_uint(char *buf, unsigned long value, unsigned char width, unsigned char flags) {
+    return fmt_digits(buf, value, (flags & FMT_PLUS) ? '+' : 0, 0, width, flags);
+}
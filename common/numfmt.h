@@ -0,0 +1,23 @@
+// integer and fixed-point to decimal text, without printf
+// shared by HW6.X and HW7
+
+#ifndef NUMFMT_H__
+#define NUMFMT_H__
+
+#include <limits.h>
+
+#define FMT_PLUS 0x01 // put a '+' on positive numbers
+#define FMT_ZERO 0x02 // pad with '0' after the sign instead of spaces before it
+#define FMT_LEFT 0x04 // left align, pad with spaces on the right
+
+// longest number without padding: sign, the digits of a long (10 for 32 bits), point, leading 0,
+// plus the 0 at the end. bits*3/10 is one less than the digits, for longs up to 64 bits
+#define FMT_MAX (sizeof(long)*CHAR_BIT*3/10 + 5)
+
+// write value/10^decimals (up to 9 decimals) into buf, padded to at least width characters, with a 0 at the end
+// buf must hold the larger of width+1 and FMT_MAX, returns the length without the 0
+int fmt_fixed(char *buf, long value, unsigned char decimals, unsigned char width, unsigned char flags);
+int fmt_int(char *buf, long value, unsigned char width, unsigned char flags);
+int fmt_uint(char *buf, unsigned long value, unsigned char width, unsigned char flags); // all of unsigned long, no '-'
+
+#endif
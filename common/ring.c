@@ -0,0 +1,47 @@
+// single producer, single consumer ring
+// the item is copied in before head moves past it and copied out before tail moves past it.
+// the barrier keeps the compiler from moving the copy to the other side of the index update,
+// and the PIC32 stores a 16 bit index in one instruction, so the other side never sees half of one
+
+#include <string.h>
+#include "ring.h"
+
+#define RING_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+void ring_init(RING *r, void *items, unsigned short size, unsigned short capacity) {
+    r->items = items;
+    r->size = size;
+    r->mask = capacity - 1;
+    r->head = 0;
+    r->tail = 0;
+}
+
+int ring_put(RING *r, const void *item) {
+    unsigned short head = r->head;
+
+    if ((unsigned short)(head - r->tail) > r->mask) {
+        return 0; // full
+    }
+    RING_BARRIER(); // the slot is free before it is written
+    memcpy(r->items + (head & r->mask) * r->size, item, r->size);
+    RING_BARRIER();
+    r->head = head + 1;
+    return 1;
+}
+
+int ring_get(RING *r, void *item) {
+    unsigned short tail = r->tail;
+
+    if (tail == r->head) {
+        return 0; // empty
+    }
+    RING_BARRIER(); // the item is all there before it is read
+    memcpy(item, r->items + (tail & r->mask) * r->size, r->size);
+    RING_BARRIER();
+    r->tail = tail + 1;
+    return 1;
+}
+
+unsigned short ring_count(const RING *r) {
+    return r->head - r->tail;
+}
@@ -0,0 +1,24 @@
+// single producer, single consumer ring of fixed size items, for passing samples from an
+// interrupt to the main loop. shared by HW6.X and HW7
+
+#ifndef RING_H__
+#define RING_H__
+
+// head is only written by ring_put and tail only by ring_get, so one side can run in an
+// interrupt and the other in the main loop without turning interrupts off. both count up
+// forever and are masked to index the buffer, which is why the capacity is a power of two
+typedef struct {
+    unsigned char *items; // capacity * size bytes, owned by the caller
+    unsigned short size; // bytes per item
+    unsigned short mask; // capacity - 1
+    volatile unsigned short head; // items put
+    volatile unsigned short tail; // items taken
+} RING;
+
+// capacity must be a power of two, up to 32768
+void ring_init(RING *r, void *items, unsigned short size, unsigned short capacity);
+int ring_put(RING *r, const void *item); // producer side, 0 if the ring is full and the item was not added
+int ring_get(RING *r, void *item); // consumer side, 0 if the ring is empty
+unsigned short ring_count(const RING *r); // items waiting, can be stale by the time it is used
+
+#endif
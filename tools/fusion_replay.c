@@ -0,0 +1,182 @@
+// replay a recorded IMU log through the fixed point Mahony filter in common/fusion.c.
+//
+//     cc -O2 -I../common -o fusion_replay fusion_replay.c ../common/fusion.c -lm
+//     ./fusion_replay [hz [mdps [kp [ki [repeat]]]]] < log.csv > angles.csv
+//     ./fusion_replay             run the built in logs and check them
+//
+// the log has one reading per line, the LSM6_READING fields as raw numbers:
+//
+//     time,temp,gx,gy,gz,ax,ay,az
+//
+// and the defaults match the projects, 1660 Hz, 8.75 mdps per LSB, kp 2 and ki 0.01. every
+// reading is written back out as time,roll,pitch in degrees. the whole log is then run repeat
+// more times (default 100) to time fusion_update, and the time per update goes to stderr, in
+// cycles too on x86 where the time stamp counter can be read. on the PIC32 bench_fusion() in
+// HW6.X measures the same thing.
+//
+// with no log on stdin, logs made up here are run at the defaults and checked: a still board
+// tilted to a known roll and pitch after a flat first reading, with a gyro bias and noise, has
+// to settle within FUSION_TOLERANCE of it, and a turn about one axis on the gyro alone has to
+// come out as that angle on its axis and nothing on the other. the exit status is the number of
+// checks that failed
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "fusion.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#define MAX_READINGS 200000
+#define HZ 1660
+#define MDPS 8.75
+#define ONE_G 16384 // raw accel at +-2 g
+#define FUSION_TOLERANCE 50 // hundredths of a degree
+#define DEG (3.14159265 / 180)
+
+static short gyro[MAX_READINGS][3], accel[MAX_READINGS][3];
+static unsigned long stamp[MAX_READINGS];
+static int failed;
+
+static void check(const char *name, int ok) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+    failed += !ok;
+}
+
+// small repeatable noise, -amplitude to amplitude
+static int noise(int amplitude) {
+    static unsigned long seed = 1;
+
+    seed = seed * 1103515245 + 12345;
+    return (int)((seed >> 16) % (2*amplitude + 1)) - amplitude;
+}
+
+// gravity as the accel reads it with the board at roll and pitch, in degrees
+static void tilt(short *a, double roll, double pitch) {
+    a[0] = (short)lround(-sin(pitch * DEG) * ONE_G);
+    a[1] = (short)lround(cos(pitch * DEG) * sin(roll * DEG) * ONE_G);
+    a[2] = (short)lround(cos(pitch * DEG) * cos(roll * DEG) * ONE_G);
+}
+
+// flat for the first reading, then still at roll and pitch for seconds, with a gyro bias
+static void settle(double roll, double pitch, int bias) {
+    FUSION f;
+    short g[3], a[3], r, p;
+    char name[100];
+    long i;
+    int k;
+
+    fusion_init(&f, FUSION_GYRO_K(MDPS, HZ), FUSION_KP(2.0, HZ), FUSION_KI(0.01, HZ));
+    g[0] = g[1] = g[2] = 0;
+    tilt(a, 0, 0);
+    fusion_update(&f, g, a);
+    for (i = 0; i < 10L*HZ; i++) {
+        tilt(a, roll, pitch);
+        for (k = 0; k < 3; k++) {
+            g[k] = (short)(bias + noise(5));
+            a[k] += noise(50);
+        }
+        fusion_update(&f, g, a);
+    }
+    fusion_angles(&f, &r, &p);
+    sprintf(name, "still at roll %.0f pitch %.0f, gyro bias %d: %.2f %.2f", roll, pitch, bias, r / 100.0, p / 100.0);
+    check(name, abs(r - (int)(roll * 100)) <= FUSION_TOLERANCE && abs(p - (int)(pitch * 100)) <= FUSION_TOLERANCE);
+}
+
+// flat, then turning at dps about one axis for the time degrees takes, with no accel so only
+// the gyro moves it. which way round the angle comes out is the sensor's, only its size is checked
+static void turn(int axis, double dps, double degrees) {
+    FUSION f;
+    short g[3] = {0, 0, 0}, a[3] = {0, 0, 0}, r, p, on, off;
+    char name[100];
+    long i, n = lround(degrees / dps * HZ);
+
+    fusion_init(&f, FUSION_GYRO_K(MDPS, HZ), FUSION_KP(2.0, HZ), FUSION_KI(0.01, HZ));
+    tilt(a, 0, 0);
+    fusion_update(&f, g, a);
+    a[0] = a[1] = a[2] = 0;
+    g[axis] = (short)lround(dps * 1000 / MDPS);
+    for (i = 0; i < n; i++) {
+        fusion_update(&f, g, a);
+    }
+    fusion_angles(&f, &r, &p);
+    on = axis == 0 ? r : p;
+    off = axis == 0 ? p : r;
+    sprintf(name, "%.0f dps about %c for %.0f degrees: roll %.2f pitch %.2f", dps, "xy"[axis], degrees, r / 100.0, p / 100.0);
+    check(name, abs(abs(on) - (int)(degrees * 100)) <= FUSION_TOLERANCE && abs(off) <= FUSION_TOLERANCE);
+}
+
+static int builtIn(void) {
+    settle(30, -20, 0);
+    settle(30, -20, 20); // about 0.18 dps the integral has to learn
+    settle(-60, 45, -20);
+    turn(0, 90, 45);
+    turn(1, 90, 45);
+    turn(0, 250, 60);
+    printf("%d failed\n", failed);
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    double hz = argc > 1 ? atof(argv[1]) : 1660;
+    double mdps = argc > 2 ? atof(argv[2]) : 8.75;
+    double kp = argc > 3 ? atof(argv[3]) : 2.0;
+    double ki = argc > 4 ? atof(argv[4]) : 0.01;
+    int repeat = argc > 5 ? atoi(argv[5]) : 100;
+    FUSION f;
+    long n = 0, i;
+    int r, temp, g[3], a[3];
+    short roll, pitch;
+    struct timespec t0, t1;
+    double ns;
+    unsigned long long c0 = 0, c1 = 0;
+
+    if (isatty(0)) {
+        return builtIn();
+    }
+    while (n < MAX_READINGS && scanf(" %lu,%d,%d,%d,%d,%d,%d,%d", &stamp[n], &temp, &g[0], &g[1], &g[2], &a[0], &a[1], &a[2]) == 8) {
+        for (i = 0; i < 3; i++) {
+            gyro[n][i] = (short)g[i];
+            accel[n][i] = (short)a[i];
+        }
+        n++;
+    }
+    if (n == 0) {
+        return builtIn();
+    }
+
+    fusion_init(&f, FUSION_GYRO_K(mdps, hz), FUSION_KP(kp, hz), FUSION_KI(ki, hz));
+    for (i = 0; i < n; i++) {
+        fusion_update(&f, gyro[i], accel[i]);
+        fusion_angles(&f, &roll, &pitch);
+        printf("%lu,%.2f,%.2f\n", stamp[i], roll / 100.0, pitch / 100.0);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+#if HAVE_TSC
+    c0 = __rdtsc();
+#endif
+    for (r = 0; r < repeat; r++) {
+        for (i = 0; i < n; i++) {
+            fusion_update(&f, gyro[i], accel[i]);
+        }
+    }
+#if HAVE_TSC
+    c1 = __rdtsc();
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / ((double)n * repeat);
+    fprintf(stderr, "%ld readings, %.1f ns per update", n, ns);
+    if (HAVE_TSC) {
+        fprintf(stderr, ", %.0f cycles", (double)(c1 - c0) / ((double)n * repeat));
+    }
+    fprintf(stderr, "\n");
+    return 0;
+}
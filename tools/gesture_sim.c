@@ -0,0 +1,190 @@
+// feed TAP_SRC sequences through HW7's gesture.c on the host and time the clicks it sends.
+//
+//     cc -std=gnu99 -I../common -I../HW7/hid_mouse/firmware/src -o gesture_sim gesture_sim.c ../HW7/hid_mouse/firmware/src/gesture.c
+//     ./gesture_sim              run the built in sequences and check them
+//     ./gesture_sim < taps.csv   replay a recording and print the clicks
+//
+// a recording has one reading per line, time,tap: the core timer count of the data ready
+// pulse and the TAP_SRC byte, as in bytes 4 to 7 and 3 of each telemetry frame from the CDC
+// port. the readings go to gesture_tap as their times come, and gesture_report is called every
+// 1 ms USB frame in between, the way app.c does. every button press and release is printed
+// with its time and how long the button was down.
+//
+// the built in sequences are readings at 1.66 kHz with taps at set times: a single tap, a
+// double tap, two single taps far apart, a double tap reported after the window, a double tap
+// while a click is going out, and readings with axis bits but no tap. each checks the clicks, that every
+// click holds its button GESTURE_PRESS reports and lets go GESTURE_GAP before the next one, and
+// that a single tap is clicked when GESTURE_DOUBLE_WINDOW reports have gone by, counting the one
+// the tap came in. the exit status is the number of sequences that failed
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "lsm6ds33.h"
+#include "gesture.h"
+
+#define CORE_TICKS_PER_SEC 24000000
+#define FRAME_TICKS (CORE_TICKS_PER_SEC / 1000) // a USB frame
+#define READING_TICKS (CORE_TICKS_PER_SEC / 1660) // the built in sequences' data ready rate
+#define MAX_READINGS 1000000
+#define IDLE_FRAMES (GESTURE_DOUBLE_WINDOW + 2*(GESTURE_PRESS + GESTURE_GAP) + 10) // after the last reading, so every click has gone out
+
+#define SINGLE (LSM6_TAP_IA | LSM6_TAP_SINGLE | 0x01) // TAP_SRC of a tap on Z
+#define DOUBLE (LSM6_TAP_IA | LSM6_TAP_DOUBLE | 0x01)
+
+typedef struct {
+    unsigned int time;
+    unsigned char tap;
+} TAP_READING;
+
+typedef struct {
+    int clicks[2]; // left, right
+    int shortestHold, longestHold; // reports a button was down
+    int shortestGap; // reports between one release and the next press, -1 with only one click
+    int firstLeft; // reports from the one with the first single tap to the first left press, -1 if there was none
+    int both; // reports with both buttons down
+} RESULT;
+
+static TAP_READING readings[MAX_READINGS];
+
+static void simulate(const TAP_READING *r, int n, RESULT *result, int print) {
+    static const char *names[2] = {"left", "right"};
+    unsigned int start = r[0].time, now;
+    int frame, frames, i = 0, b, lastRelease = -1, firstSingle = -1;
+    int downAt[2] = {0, 0};
+    unsigned char buttons, last = 0;
+
+    frames = (r[n - 1].time - start) / FRAME_TICKS + IDLE_FRAMES;
+    result->clicks[0] = result->clicks[1] = 0;
+    result->shortestHold = 1000000;
+    result->longestHold = 0;
+    result->shortestGap = -1;
+    result->firstLeft = -1;
+    result->both = 0;
+    for (frame = 1; frame <= frames; frame++) {
+        now = start + frame * FRAME_TICKS;
+        while (i < n && (int)(r[i].time - now) < 0) {
+            if (firstSingle < 0 && (r[i].tap & LSM6_TAP_SINGLE)) {
+                firstSingle = frame;
+            }
+            gesture_tap(r[i++].tap);
+        }
+        buttons = gesture_report();
+        result->both += buttons == (GESTURE_LEFT | GESTURE_RIGHT);
+        for (b = 0; b < 2; b++) {
+            unsigned char bit = b ? GESTURE_RIGHT : GESTURE_LEFT;
+
+            if ((buttons & bit) && !(last & bit)) {
+                result->clicks[b]++;
+                downAt[b] = frame;
+                if (lastRelease >= 0 && (result->shortestGap < 0 || frame - lastRelease < result->shortestGap)) {
+                    result->shortestGap = frame - lastRelease;
+                }
+                if (b == 0 && result->firstLeft < 0 && firstSingle >= 0) {
+                    result->firstLeft = frame - firstSingle;
+                }
+                if (print) {
+                    printf("%10.1f ms %s down\n", (now - start) / (FRAME_TICKS / 1.0), names[b]);
+                }
+            } else if (!(buttons & bit) && (last & bit)) {
+                lastRelease = frame;
+                if (frame - downAt[b] < result->shortestHold) {
+                    result->shortestHold = frame - downAt[b];
+                }
+                if (frame - downAt[b] > result->longestHold) {
+                    result->longestHold = frame - downAt[b];
+                }
+                if (print) {
+                    printf("%10.1f ms %s up, held %d ms\n", (now - start) / (FRAME_TICKS / 1.0), names[b], frame - downAt[b]);
+                }
+            }
+        }
+        last = buttons;
+    }
+}
+
+// readings at 1.66 kHz for ms, with tap[k] in the reading at at[k] ms
+static int sequence(const int *at, const unsigned char *tap, int taps, int ms) {
+    int n = 0, k = 0;
+
+    while (n < MAX_READINGS && n * (long)READING_TICKS < ms * (long)FRAME_TICKS) {
+        readings[n].time = 1000 + n * READING_TICKS;
+        readings[n].tap = 0x01; // the axis bits come without a tap too
+        if (k < taps && n * (long)READING_TICKS >= at[k] * (long)FRAME_TICKS) {
+            readings[n].tap = tap[k++];
+        }
+        n++;
+    }
+    return n;
+}
+
+static int check(const char *name, const int *at, const unsigned char *tap, int taps, int ms, int left, int right) {
+    RESULT r;
+    int n = sequence(at, tap, taps, ms), ok;
+
+    simulate(readings, n, &r, 0);
+    ok = r.clicks[0] == left && r.clicks[1] == right && r.both == 0;
+    if (left + right) {
+        ok &= r.shortestHold == GESTURE_PRESS && r.longestHold == GESTURE_PRESS;
+    }
+    if (left + right > 1) {
+        ok &= r.shortestGap >= GESTURE_GAP;
+    }
+    if (left && r.firstLeft >= 0) {
+        ok &= r.firstLeft == GESTURE_DOUBLE_WINDOW - 1;
+    }
+    printf("%s %-34s left %d right %d", ok ? "ok  " : "FAIL", name, r.clicks[0], r.clicks[1]);
+    if (left + right) {
+        printf(", held %d reports", r.longestHold);
+    }
+    if (r.shortestGap >= 0) {
+        printf(", gap %d", r.shortestGap);
+    }
+    if (r.firstLeft >= 0) {
+        printf(", left %d reports after the tap", r.firstLeft);
+    }
+    printf("\n");
+    return !ok;
+}
+
+static int builtIn(void) {
+    static const int single[] = {100}, twice[] = {100, 250}, apart[] = {100, 600}, late[] = {100, 395}, close[] = {100, 400, 410};
+    static const unsigned char s[] = {SINGLE}, sd[] = {SINGLE, DOUBLE}, ss[] = {SINGLE, SINGLE}, sdd[] = {SINGLE, SINGLE, DOUBLE};
+    static const unsigned char axis[] = {0x07};
+    int failed = 0;
+
+    failed += check("single tap", single, s, 1, 1000, 1, 0);
+    failed += check("double tap", twice, sd, 2, 1000, 0, 1);
+    failed += check("two single taps apart", apart, ss, 2, 1500, 2, 0);
+    failed += check("double tap after the window", late, sd, 2, 1000, 1, 1);
+    // the left click is going out when the double tap comes, so the right one waits its turn
+    failed += check("double tap during a click", close, sdd, 3, 1500, 1, 1);
+    failed += check("axis bits without a tap", single, axis, 1, 500, 0, 0);
+    printf("%d failed\n", failed);
+    return failed;
+}
+
+int main(void) {
+    RESULT r;
+    unsigned int time;
+    int tap;
+    char line[100];
+    int n = 0;
+
+    if (isatty(0)) {
+        return builtIn();
+    }
+    while (n < MAX_READINGS && fgets(line, sizeof(line), stdin)) {
+        if (sscanf(line, "%u,%i", &time, &tap) == 2) {
+            readings[n].time = time;
+            readings[n].tap = tap;
+            n++;
+        }
+    }
+    if (n == 0) {
+        return builtIn();
+    }
+    simulate(readings, n, &r, 1);
+    printf("%d readings, left %d clicks, right %d clicks\n", n, r.clicks[0], r.clicks[1]);
+    return 0;
+}
@@ -0,0 +1 @@
+// empty host stand-in for the Harmony header, HW7's mouse.h uses nothing from it
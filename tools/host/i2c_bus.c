@@ -0,0 +1,164 @@
+// simulated I2C2 bus
+// the master starts one thing at a time: a START, RESTART or STOP from I2C2CON, a byte by
+// writing I2C2TRN, a byte read with RCEN, or an ACK with ACKEN. I2C2TRN is left at
+// I2C_BUS_EMPTY after each byte, so a write to it shows a byte was started
+
+#include <stdio.h>
+#include <string.h>
+#include <xc.h>
+#include "i2c_engine.h"
+#include "i2c_bus.h"
+
+#define I2C_BUS_EMPTY 0x100
+#define I2C_BUS_SLAVES 8
+
+// what the next byte the master sends is
+#define PH_IDLE 0
+#define PH_ADDRESS 1
+#define PH_REG 2
+#define PH_DATA 3
+
+unsigned long i2c_bus_starts;
+unsigned long i2c_bus_bytes;
+unsigned int i2c_bus_bitTicks = 60;
+char i2c_bus_log[I2C_BUS_LOG];
+
+static I2C_BUS_SLAVE *slaves[I2C_BUS_SLAVES];
+static int slaveCount;
+static I2C_BUS_SLAVE *selected; // the slave that ACKed the last address
+static int phase;
+static int logLength;
+
+static void i2c_bus_log_(const char *fmt, unsigned int v) {
+    if (logLength < I2C_BUS_LOG - 16) {
+        logLength += sprintf(i2c_bus_log + logLength, fmt, v);
+    }
+}
+
+static I2C_BUS_SLAVE *i2c_bus_find(unsigned char address) {
+    int i;
+
+    for (i = 0; i < slaveCount; i++) {
+        if (slaves[i]->address == address) {
+            return slaves[i];
+        }
+    }
+    return 0;
+}
+
+void i2c_bus_reset(void) {
+    slaveCount = 0;
+    selected = 0;
+    phase = PH_IDLE;
+    logLength = 0;
+    i2c_bus_log[0] = 0;
+    i2c_bus_starts = 0;
+    i2c_bus_bytes = 0;
+    I2C2TRN = I2C_BUS_EMPTY;
+    I2C2STATbits.ACKSTAT = 0;
+    I2C2STATbits.BCL = 0;
+}
+
+void i2c_bus_attach(I2C_BUS_SLAVE *slave) {
+    if (slaveCount < I2C_BUS_SLAVES) {
+        slaves[slaveCount++] = slave;
+    }
+}
+
+// the master sent a byte, the slave ACKs or NACKs it
+static void i2c_bus_byte(unsigned int v) {
+    int nack = 0;
+
+    i2c_bus_bytes++;
+    switch (phase) {
+        case PH_ADDRESS:
+            selected = i2c_bus_find(v >> 1);
+            nack = selected == 0;
+            i2c_bus_log_("a%02X", v >> 1);
+            i2c_bus_log_(nack ? "-" : "+", 0);
+            i2c_bus_log_(v & 1 ? "r " : "w ", 0);
+            phase = nack || (v & 1) ? PH_IDLE : PH_REG;
+            break;
+
+        case PH_REG:
+            selected->pointer = v;
+            i2c_bus_log_("R%02X ", v);
+            phase = PH_DATA;
+            break;
+
+        case PH_DATA:
+            i2c_bus_log_("w%02X ", v);
+            if (selected->nackReg == selected->pointer) {
+                nack = 1;
+                break;
+            }
+            selected->regs[selected->pointer] = v;
+            selected->pointer += selected->autoIncrement;
+            break;
+
+        default: // a byte nobody is listening to
+            nack = 1;
+            break;
+    }
+    I2C2STATbits.ACKSTAT = nack;
+}
+
+int i2c_bus_step(void) {
+    unsigned int bits;
+
+    if (I2C2CONbits.SEN || I2C2CONbits.RSEN) {
+        i2c_bus_log_(I2C2CONbits.SEN ? "S " : "Sr ", 0);
+        i2c_bus_starts += I2C2CONbits.SEN;
+        I2C2CONbits.SEN = 0;
+        I2C2CONbits.RSEN = 0;
+        phase = PH_ADDRESS;
+        bits = 1;
+    } else if (I2C2CONbits.PEN) {
+        I2C2CONbits.PEN = 0;
+        i2c_bus_log_("P ", 0);
+        selected = 0;
+        phase = PH_IDLE;
+        bits = 1;
+    } else if (I2C2CONbits.RCEN) {
+        I2C2CONbits.RCEN = 0;
+        I2C2RCV = selected ? selected->regs[selected->pointer] : 0xFF; // nobody drives SDA, it reads high
+        if (selected) {
+            selected->pointer += selected->autoIncrement;
+        }
+        i2c_bus_bytes++;
+        i2c_bus_log_("r%02X ", I2C2RCV);
+        bits = 8;
+    } else if (I2C2CONbits.ACKEN) {
+        I2C2CONbits.ACKEN = 0;
+        i2c_bus_log_(I2C2CONbits.ACKDT ? "N " : "A ", 0);
+        bits = 1;
+    } else if (I2C2TRN != I2C_BUS_EMPTY) {
+        i2c_bus_byte(I2C2TRN & 0xFF);
+        I2C2TRN = I2C_BUS_EMPTY;
+        bits = 9;
+    } else {
+        return 0;
+    }
+    host_core += bits * i2c_bus_bitTicks;
+    IFS1bits.I2C2MIF = 1;
+    return 1;
+}
+
+int i2c_bus_run(int steps) {
+    int n = 0;
+
+    while (i2c_engine_busy() && n < steps) {
+        i2c_bus_step();
+        i2c_engine_tasks();
+        n++;
+    }
+    return n;
+}
+
+static void i2c_bus_onCount(void) {
+    i2c_bus_step();
+}
+
+void i2c_bus_background(int on) {
+    host_onCount = on ? i2c_bus_onCount : 0;
+}
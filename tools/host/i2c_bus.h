@@ -0,0 +1,35 @@
+// simulated I2C2 bus for the host tests: register file slaves answer whatever the master in
+// common/i2c_engine.c starts on the I2C2 registers. each i2c_bus_step finishes the one step the
+// master started, moves the core timer on by the bit times it took, and sets the master
+// interrupt flag, the way the module does
+
+#ifndef I2C_BUS_H__
+#define I2C_BUS_H__
+
+#define I2C_BUS_LOG 4096 // bytes of log kept
+
+typedef struct {
+    unsigned char address; // 7 bit
+    unsigned char autoIncrement; // 1 if the register pointer steps on after each byte
+    int nackReg; // a data byte written to this register is NACKed, -1 for none
+    unsigned char regs[256];
+    unsigned char pointer; // register pointer, set by the byte after a write address
+} I2C_BUS_SLAVE;
+
+// counted since i2c_bus_reset
+extern unsigned long i2c_bus_starts; // START conditions, one per transaction
+extern unsigned long i2c_bus_bytes; // bytes on the bus, addresses included
+extern unsigned int i2c_bus_bitTicks; // core timer ticks per bit, 60 (400 kHz) to start with
+// what went over the bus: S start, Sr restart, P stop, a6B+/a6B- an address ACKed/NACKed
+// (+w or +r), R20 the register byte, w55 a byte written, r55 a byte read, A and N the master's ACK or NACK
+extern char i2c_bus_log[I2C_BUS_LOG];
+
+void i2c_bus_reset(void); // no slaves, empty log, counters zeroed
+void i2c_bus_attach(I2C_BUS_SLAVE *slave);
+int i2c_bus_step(void); // finish the master's step, 0 if it had none going
+// step the bus and the engine in polled mode until it is idle, at most steps times, and return how many it took
+int i2c_bus_run(int steps);
+// 1 steps the bus on every core timer read, for code that blocks in i2c_engine_wait
+void i2c_bus_background(int on);
+
+#endif
@@ -0,0 +1,28 @@
+// the registers and core timer of the host stand-in
+
+#include <xc.h>
+
+#define HOST_REG(n) volatile unsigned int n; volatile HOST_BITS n##bits;
+#include "regs.h"
+#undef HOST_REG
+
+volatile unsigned int host_core = 0;
+unsigned int host_coreStep = 7;
+int host_interrupts = 1;
+void (*host_onCount)(void) = 0;
+
+unsigned int host_coreCount(void) {
+    host_core += host_coreStep;
+    if (host_onCount) {
+        host_onCount();
+    }
+    return host_core;
+}
+
+// returns the status with IE in bit 0, like the di instruction
+unsigned int host_disableInterrupts(void) {
+    unsigned int s = host_interrupts;
+
+    host_interrupts = 0;
+    return s;
+}
@@ -0,0 +1,14 @@
+// the registers the host stand-in has, included by xc.h and regs.c with HOST_REG defined
+HOST_REG(ANSELB) HOST_REG(TRISA) HOST_REG(TRISB) HOST_REG(LATA) HOST_REG(LATB) HOST_REG(PORTB)
+HOST_REG(ODCB) HOST_REG(CNPUB) HOST_REG(CNENB) HOST_REG(CNCONB) HOST_REG(CNSTATB)
+HOST_REG(SDI1R) HOST_REG(RPA1R) HOST_REG(RPB13R) HOST_REG(RPB14R) HOST_REG(INT2R) HOST_REG(INT4R)
+HOST_REG(SPI1CON) HOST_REG(SPI1CONSET) HOST_REG(SPI1CONCLR) HOST_REG(SPI1STAT) HOST_REG(SPI1BUF) HOST_REG(SPI1BRG)
+HOST_REG(I2C2CON) HOST_REG(I2C2CONSET) HOST_REG(I2C2CONCLR) HOST_REG(I2C2STAT) HOST_REG(I2C2BRG)
+HOST_REG(I2C2TRN) HOST_REG(I2C2RCV)
+HOST_REG(INTCON) HOST_REG(IFS0) HOST_REG(IFS0CLR) HOST_REG(IFS1) HOST_REG(IFS1CLR) HOST_REG(IEC0) HOST_REG(IEC1)
+HOST_REG(IPC1) HOST_REG(IPC2) HOST_REG(IPC4) HOST_REG(IPC7) HOST_REG(IPC8) HOST_REG(IPC9) HOST_REG(IPC10)
+HOST_REG(DMACON) HOST_REG(DCH0CON) HOST_REG(DCH0CONSET) HOST_REG(DCH0CONCLR) HOST_REG(DCH0ECON) HOST_REG(DCH0ECONSET)
+HOST_REG(DCH0INT) HOST_REG(DCH0INTCLR) HOST_REG(DCH0SSA) HOST_REG(DCH0DSA) HOST_REG(DCH0SSIZ) HOST_REG(DCH0DSIZ)
+HOST_REG(DCH0CSIZ)
+HOST_REG(NVMCON) HOST_REG(NVMCONSET) HOST_REG(NVMCONCLR) HOST_REG(NVMADDR) HOST_REG(NVMDATA) HOST_REG(NVMKEY)
+HOST_REG(BMXCON) HOST_REG(DDPCON)
@@ -0,0 +1,12 @@
+// host stand-in for the XC32 <sys/attribs.h>, an interrupt handler is a plain function the test calls
+
+#ifndef HOST_ATTRIBS_H__
+#define HOST_ATTRIBS_H__
+
+#define __ISR(vector, ipl)
+#define IPL2SOFT
+#define IPL3SOFT
+#define IPL4SOFT
+#define IPL5SOFT
+
+#endif
@@ -0,0 +1,8 @@
+// host stand-in for the XC32 <sys/kmem.h>
+
+#ifndef HOST_KMEM_H__
+#define HOST_KMEM_H__
+
+#define KVA_TO_PA(v) ((unsigned long)(v) & 0x1FFFFFFF)
+
+#endif
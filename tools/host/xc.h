@@ -0,0 +1,64 @@
+// host stand-in for the XC32 <xc.h>, so the shared code builds with cc for the tests in tools/.
+// every register is a plain word plus a bitfield struct that has every field the tree uses,
+// so FOObits.X and FOO are separate variables here and a test sets and reads them by hand.
+// the core timer steps on by host_coreStep each time it is read, so spin loops end, and
+// host_onCount is called on every read, so a simulated peripheral can move on while the
+// code under test spins on the timer
+
+#ifndef HOST_XC_H__
+#define HOST_XC_H__
+
+typedef struct {
+    // SPI1
+    unsigned ON:1, MSTEN:1, CKE:1, CKP:1, SMP:1, MODE16:1, MODE32:1, ENHBUF:1, STXISEL:2, DISSDI:1;
+    unsigned SPIROV:1, SPIRBF:1, SPITBF:1, SPITBE:1, SPIRBE:1, SPIBUSY:1, SRMT:1;
+    unsigned SPI1TXIF:1, SPI1TXIE:1, SPI1IP:3;
+    // I2C2
+    unsigned SEN:1, RSEN:1, PEN:1, RCEN:1, ACKEN:1, ACKDT:1, DISSLW:1, SMEN:1;
+    unsigned TRSTAT:1, ACKSTAT:1, RBF:1, TBF:1, BCL:1, IWCOL:1, I2COV:1, P:1, S:1;
+    unsigned I2C2MIF:1, I2C2MIE:1, I2C2MIP:3, I2C2IP:3, I2C2BIF:1, I2C2BIE:1;
+    // ports, peripheral pin select and change notice
+    unsigned TRISA4:1, LATA4:1, TRISB2:1, TRISB3:1, TRISB4:1, TRISB7:1, TRISB13:1, TRISB15:1;
+    unsigned LATB2:1, LATB3:1, LATB7:1, LATB15:1, RB2:1, RB3:1, RB4:1, RB13:1;
+    unsigned ANSB2:1, ANSB3:1, ANSB13:1, ANSB14:1, ANSB15:1;
+    unsigned SDI1R:4, RPA1R:4, INT2R:4, INT4R:4;
+    unsigned CNIEB:1, CNIEB13:1, CNIFB:1, CNIP:3, CNIE:1;
+    // external interrupts
+    unsigned INT2IF:1, INT2IE:1, INT2IP:3, INT2EP:1, INT4IF:1, INT4IE:1, INT4IP:3, INT4EP:1;
+    // DMA channel 0
+    unsigned CHEN:1, CHPRI:2, CHSIRQ:8, SIRQEN:1, CFORCE:1, DMABUSY:1;
+    unsigned CHBCIF:1, CHBCIE:1, CHERIF:1, CHTAIF:1, CHDDIF:1, CHSDIF:1;
+    unsigned DMA0IF:1, DMA0IE:1, DMA0IP:3;
+    // system
+    unsigned BMXWSDRM:1, MVEC:1, JTAGEN:1;
+} HOST_BITS;
+
+#define HOST_REG(n) extern volatile unsigned int n; extern volatile HOST_BITS n##bits;
+#include "regs.h"
+#undef HOST_REG
+
+extern volatile unsigned int host_core; // the core timer
+extern unsigned int host_coreStep; // ticks each read of it takes, 7 to start with
+extern int host_interrupts; // 1 while interrupts are on
+extern void (*host_onCount)(void); // can be 0
+unsigned int host_coreCount(void);
+unsigned int host_disableInterrupts(void);
+
+#define _CP0_GET_COUNT() host_coreCount()
+#define _CP0_SET_COUNT(x) (host_core = (x))
+#define __builtin_disable_interrupts() host_disableInterrupts()
+#define __builtin_enable_interrupts() (host_interrupts = 1)
+#define __builtin_mtc0(reg, sel, value) ((void)(value))
+#define _CP0_CONFIG 16
+#define _CP0_CONFIG_SELECT 0
+
+// vector and IRQ numbers of the PIC32MX250F128B
+#define _EXTERNAL_2_VECTOR 11
+#define _EXTERNAL_4_VECTOR 19
+#define _SPI_1_VECTOR 31
+#define _CHANGE_NOTICE_VECTOR 34
+#define _DMA_0_VECTOR 36
+#define _I2C_2_VECTOR 37
+#define _SPI1_TX_IRQ 36
+
+#endif
@@ -0,0 +1,168 @@
+// run the register map layer in common/i2c_dev.c through the I2C2 engine against simulated
+// register file slaves on the host.
+//
+//     cc -std=gnu99 -Ihost -I../common -o i2c_dev_test i2c_dev_test.c host/i2c_bus.c host/regs.c ../common/i2c_dev.c ../common/i2c_engine.c
+//     ./i2c_dev_test
+//
+// i2c_dev blocks in i2c_engine_wait, so the bus is stepped on every core timer read. the
+// slave without auto-increment keeps its register pointer where it was set, so a burst to it
+// would land every byte on one register and the checks below would see it. the exit status is
+// the number of cases that failed
+
+#include <stdio.h>
+#include <string.h>
+#include <xc.h>
+#include "i2c_engine.h"
+#include "i2c_dev.h"
+#include "i2c_bus.h"
+
+static I2C_BUS_SLAVE burstSlave, singleSlave;
+static const I2C_DEV burst = {0x6B, 1}, single = {0x1E, 0}, absent = {0x55, 1};
+static int failed;
+
+static void setup(void) {
+    i2c_bus_reset();
+    memset(&burstSlave, 0, sizeof(burstSlave));
+    burstSlave.address = burst.address;
+    burstSlave.autoIncrement = 1;
+    burstSlave.nackReg = -1;
+    memset(&singleSlave, 0, sizeof(singleSlave));
+    singleSlave.address = single.address;
+    singleSlave.nackReg = -1;
+    i2c_bus_attach(&burstSlave);
+    i2c_bus_attach(&singleSlave);
+    i2c_engine_init(1);
+    i2c_bus_background(1);
+}
+
+static void check(const char *name, int ok) {
+    printf("%s %s (%lu transactions, %lu bytes)\n", ok ? "ok  " : "FAIL", name, i2c_bus_starts, i2c_bus_bytes);
+    if (!ok) {
+        printf("     %s\n", i2c_bus_log);
+        failed++;
+    }
+}
+
+// the LSM6DS33 init table, out of order at the end, is three runs: 10-12, 0D, 20-21
+static const I2C_REG table[] = {
+    {0x10, 0x81}, {0x11, 0x80}, {0x12, 0x04}, {0x0D, 0x01}, {0x20, 0x07}, {0x21, 0x08},
+};
+#define TABLE_LEN (int)(sizeof(table) / sizeof(table[0]))
+
+static int tableWritten(const unsigned char *regs) {
+    int i;
+
+    for (i = 0; i < TABLE_LEN; i++) {
+        if (regs[table[i].reg] != table[i].value) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void initMerges(void) {
+    signed char status;
+
+    setup();
+    status = i2c_dev_init(&burst, table, TABLE_LEN);
+    check("init merges runs", status == I2C_DONE && tableWritten(burstSlave.regs)
+        && i2c_bus_starts == 3 && i2c_bus_bytes == 3*2 + TABLE_LEN
+        && strcmp(i2c_bus_log, "S a6B+w R10 w81 w80 w04 P S a6B+w R0D w01 P S a6B+w R20 w07 w08 P ") == 0);
+}
+
+// a run longer than I2C_DEV_BURST is split into bursts of at most 32
+static void initLongRun(void) {
+    I2C_REG longTable[40];
+    signed char status;
+    int i, ok = 1;
+
+    setup();
+    for (i = 0; i < 40; i++) {
+        longTable[i].reg = 0x40 + i;
+        longTable[i].value = 0x80 + i;
+    }
+    status = i2c_dev_init(&burst, longTable, 40);
+    for (i = 0; i < 40; i++) {
+        ok &= burstSlave.regs[0x40 + i] == 0x80 + i;
+    }
+    check("init splits long runs", status == I2C_DONE && ok && i2c_bus_starts == 2);
+}
+
+static void initSingle(void) {
+    signed char status;
+
+    setup();
+    status = i2c_dev_init(&single, table, TABLE_LEN);
+    check("init without auto-increment writes one register per transaction",
+        status == I2C_DONE && tableWritten(singleSlave.regs) && i2c_bus_starts == TABLE_LEN);
+}
+
+static void readSingle(void) {
+    unsigned char values[3];
+    signed char status;
+
+    setup();
+    singleSlave.regs[0x03] = 0x11;
+    singleSlave.regs[0x04] = 0x22;
+    singleSlave.regs[0x05] = 0x33;
+    status = i2c_dev_read(&single, 0x03, values, 3);
+    check("read without auto-increment reads one register per transaction", status == I2C_DONE
+        && values[0] == 0x11 && values[1] == 0x22 && values[2] == 0x33 && i2c_bus_starts == 3);
+}
+
+static void readBurst(void) {
+    unsigned char values[6];
+    signed char status;
+    int i, ok = 1;
+
+    setup();
+    for (i = 0; i < 6; i++) {
+        burstSlave.regs[0x28 + i] = 0xA0 + i;
+    }
+    status = i2c_dev_read(&burst, 0x28, values, 6);
+    for (i = 0; i < 6; i++) {
+        ok &= values[i] == 0xA0 + i;
+    }
+    check("burst read", status == I2C_DONE && ok && i2c_bus_starts == 1);
+}
+
+static void update(void) {
+    signed char status;
+
+    setup();
+    burstSlave.regs[0x12] = 0x44;
+    status = i2c_dev_update(&burst, 0x12, 0x0C, 0x08);
+    check("update changes only the masked bits", status == I2C_DONE && burstSlave.regs[0x12] == 0x48
+        && i2c_bus_starts == 2);
+}
+
+// the first error stops the table, and the rest is not written
+static void errors(void) {
+    signed char status;
+
+    setup();
+    check("absent device", i2c_dev_init(&absent, table, TABLE_LEN) == I2C_NACK
+        && i2c_dev_update(&absent, 0x12, 1, 1) == I2C_NACK);
+    setup();
+    burstSlave.nackReg = 0x0D;
+    status = i2c_dev_init(&burst, table, TABLE_LEN);
+    check("NACK stops the table", status == I2C_NACK && burstSlave.regs[0x10] == 0x81
+        && burstSlave.regs[0x20] == 0 && i2c_bus_starts == 2);
+    setup();
+    singleSlave.nackReg = 0x11;
+    status = i2c_dev_init(&single, table, TABLE_LEN);
+    check("NACK stops the split writes", status == I2C_NACK && singleSlave.regs[0x10] == 0x81
+        && singleSlave.regs[0x12] == 0 && i2c_bus_starts == 2);
+}
+
+int main(void) {
+    initMerges();
+    initLongRun();
+    initSingle();
+    readSingle();
+    readBurst();
+    update();
+    errors();
+    printf("%d failed\n", failed);
+    return failed;
+}
@@ -0,0 +1,172 @@
+// run the I2C2 engine in common/i2c_engine.c against simulated register file slaves on the host.
+//
+//     cc -std=gnu99 -Ihost -I../common -o i2c_engine_test i2c_engine_test.c host/i2c_bus.c host/regs.c ../common/i2c_engine.c
+//     ./i2c_engine_test
+//
+// each case queues transactions, steps the bus until the engine is idle, and compares what went
+// over the bus (see host/i2c_bus.h for the log letters), the statuses, and the bytes moved. a
+// failing case prints both logs, and the exit status is the number of cases that failed
+
+#include <stdio.h>
+#include <string.h>
+#include <xc.h>
+#include "i2c_engine.h"
+#include "i2c_bus.h"
+
+static I2C_BUS_SLAVE imu;
+static int failed, callbacks;
+static I2C_TXN *order[8];
+
+static void done(I2C_TXN *txn) {
+    if (callbacks < 8) {
+        order[callbacks] = txn;
+    }
+    callbacks++;
+}
+
+static void setup(void) {
+    int i;
+
+    i2c_bus_reset();
+    memset(&imu, 0, sizeof(imu));
+    imu.address = 0x6B;
+    imu.autoIncrement = 1;
+    imu.nackReg = -1;
+    for (i = 0; i < 256; i++) {
+        imu.regs[i] = i;
+    }
+    i2c_bus_attach(&imu);
+    callbacks = 0;
+    i2c_engine_stats = (I2C_STATS){0};
+    i2c_engine_init(1);
+    PORTBbits.RB2 = 1; // SDA high, nothing holding it
+}
+
+static void check(const char *name, int ok, const char *expected) {
+    if (ok && (expected == 0 || strcmp(i2c_bus_log, expected) == 0)) {
+        printf("ok   %s\n", name);
+        return;
+    }
+    failed++;
+    printf("FAIL %s\n", name);
+    if (expected) {
+        printf("     expected %s\n     got      %s\n", expected, i2c_bus_log);
+    }
+}
+
+// a burst read goes out as reg write, RESTART, read, with the last byte NACKed
+static void readBurst(void) {
+    I2C_TXN t;
+    unsigned char rx[3];
+
+    setup();
+    i2c_engine_read(&t, 0x6B, 0x20, rx, 3, done);
+    i2c_bus_run(100);
+    check("read with repeated start", t.status == I2C_DONE && callbacks == 1
+        && rx[0] == 0x20 && rx[1] == 0x21 && rx[2] == 0x22,
+        "S a6B+w R20 Sr a6B+r r20 A r21 A r22 N P ");
+}
+
+static void writeBurst(void) {
+    I2C_TXN t;
+    const unsigned char tx[2] = {0xAA, 0xBB};
+
+    setup();
+    i2c_engine_write(&t, 0x6B, 0x10, tx, 2, done);
+    i2c_bus_run(100);
+    check("write", t.status == I2C_DONE && imu.regs[0x10] == 0xAA && imu.regs[0x11] == 0xBB,
+        "S a6B+w R10 wAA wBB P ");
+}
+
+// an address nobody answers gets a STOP straight away, and the queue carries on
+static void addressNack(void) {
+    I2C_TXN a, b;
+    unsigned char rx[2];
+
+    setup();
+    i2c_engine_read(&a, 0x55, 0x00, rx, 2, done);
+    i2c_engine_read(&b, 0x6B, 0x0F, rx, 1, done);
+    i2c_bus_run(100);
+    check("address NACK", a.status == I2C_NACK && b.status == I2C_DONE && rx[0] == 0x0F
+        && i2c_engine_stats.nacks == 1,
+        "S a55-w P S a6B+w R0F Sr a6B+r r0F N P ");
+}
+
+static void dataNack(void) {
+    I2C_TXN t;
+    const unsigned char tx[3] = {1, 2, 3};
+
+    setup();
+    imu.nackReg = 0x31;
+    i2c_engine_write(&t, 0x6B, 0x30, tx, 3, done);
+    i2c_bus_run(100);
+    check("data NACK", t.status == I2C_NACK && imu.regs[0x30] == 1 && imu.regs[0x32] == 0x32,
+        "S a6B+w R30 w01 w02 P ");
+}
+
+// transactions submitted while one is on the bus go in order, and callbacks come in that order
+static void queued(void) {
+    I2C_TXN a, b, c;
+    unsigned char ra[2], rc[1];
+    const unsigned char tx[1] = {0x5A};
+
+    setup();
+    i2c_engine_read(&a, 0x6B, 0x00, ra, 2, done);
+    i2c_bus_step();
+    i2c_engine_tasks(); // a is on the bus
+    i2c_engine_write(&b, 0x6B, 0x40, tx, 1, done);
+    i2c_engine_read(&c, 0x6B, 0x40, rc, 1, done);
+    i2c_bus_run(100);
+    check("queue order", callbacks == 3 && order[0] == &a && order[1] == &b && order[2] == &c
+        && rc[0] == 0x5A && !i2c_engine_busy(), 0);
+}
+
+// nothing answers at all, so the deadline gives up, the bus is cleared, and the next one runs
+static void timeout(void) {
+    I2C_TXN a, b;
+    unsigned char rx[14];
+    unsigned int started;
+    int n = 0;
+
+    setup();
+    i2c_engine_setSpeed(48000000, 400000);
+    started = host_core;
+    i2c_engine_read(&a, 0x6B, 0x28, rx, 14, done);
+    i2c_engine_read(&b, 0x6B, 0x28, rx, 1, done);
+    while (a.status == I2C_PENDING && n++ < 1000000) {
+        i2c_engine_tasks(); // the bus is never stepped
+    }
+    check("timeout", a.status == I2C_TIMEOUT && b.status == I2C_PENDING
+        && i2c_engine_stats.timeouts == 1 && i2c_engine_stats.recoveries == 1
+        && i2c_engine_stats.stuck == 0 && I2C2CONbits.ON, 0);
+    printf("     gave up after %.2f ms\n", (host_core - started) / (I2C_CORE_TICKS_PER_SEC / 1000.0));
+    i2c_bus_run(100);
+    check("after timeout", b.status == I2C_DONE && rx[0] == 0x28,
+        "S a6B+w R28 Sr a6B+r r28 N P ");
+}
+
+static void collision(void) {
+    I2C_TXN t;
+    unsigned char rx[1];
+
+    setup();
+    PORTBbits.RB2 = 0; // and a slave keeps SDA low through the bus clear
+    i2c_engine_read(&t, 0x6B, 0x00, rx, 1, done);
+    I2C2STATbits.BCL = 1;
+    IFS1bits.I2C2BIF = 1;
+    i2c_engine_tasks();
+    check("collision", t.status == I2C_COLLISION && I2C2STATbits.BCL == 0 && !i2c_engine_busy()
+        && i2c_engine_stats.collisions == 1 && i2c_engine_stats.stuck == 1, 0);
+}
+
+int main(void) {
+    readBurst();
+    writeBurst();
+    addressNack();
+    dataNack();
+    queued();
+    timeout();
+    collision();
+    printf("%d failed\n", failed);
+    return failed;
+}
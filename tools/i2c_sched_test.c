@@ -0,0 +1,155 @@
+// run the I2C2 bus scheduler in common/i2c_sched.c through the engine against simulated
+// register file slaves on the host, with data ready reads of the IMU going to the engine
+// directly in between, the way lsm6ds33.c does them.
+//
+//     cc -std=gnu99 -Ihost -I../common -o i2c_sched_test i2c_sched_test.c host/i2c_bus.c host/regs.c ../common/i2c_sched.c ../common/i2c_engine.c
+//     ./i2c_sched_test
+//
+// a second at 400 kHz is run, then the data the jobs moved is checked, and each device's bus
+// time per transaction is checked against the bits its transactions take, so the time a
+// transaction waited behind others before its START is not counted. the total has to cover
+// the reads of a device that was never added. prints the stats, and the exit status is the
+// number of checks that failed
+
+#include <stdio.h>
+#include <string.h>
+#include <xc.h>
+#include "i2c_engine.h"
+#include "i2c_sched.h"
+#include "i2c_bus.h"
+
+#define TICKS_PER_SEC I2C_CORE_TICKS_PER_SEC
+#define DRDY_HZ 1660 // the IMU's data ready reads, 18 bytes from TAP_SRC
+#define OTHER_HZ 10 // reads of the device that is not added, 4 bytes
+#define MAG_HZ 100
+
+static I2C_BUS_SLAVE imuSlave, magSlave, eepSlave, otherSlave;
+static I2C_SCHED_DEV imu = {0x6B, 1, 0}, mag = {0x1E, 1, 1}, eep = {0x50, 1, 2};
+// the field and status registers touch, so they are read as one burst
+static unsigned char field[6], status[1], eepRead[2];
+static const unsigned char eepData[2] = {0x11, 0x22};
+static I2C_JOB fieldJob = {&mag, 0x03, 0, field, 6, TICKS_PER_SEC/MAG_HZ};
+static I2C_JOB statusJob = {&mag, 0x09, 0, status, 1, TICKS_PER_SEC/MAG_HZ};
+static I2C_JOB eepWrite = {&eep, 0x10, eepData, 0, 2, 0};
+static I2C_JOB eepJob = {&eep, 0x10, 0, eepRead, 2, 0};
+static I2C_TXN drdyTxn, otherTxn;
+static unsigned char drdyData[18], otherData[4];
+static unsigned long drdyReads, drdyMissed, otherReads;
+static int failed;
+
+static void slave(I2C_BUS_SLAVE *s, unsigned char address) {
+    int i;
+
+    memset(s, 0, sizeof(*s));
+    s->address = address;
+    s->autoIncrement = 1;
+    s->nackReg = -1;
+    for (i = 0; i < 256; i++) {
+        s->regs[i] = address ^ i;
+    }
+    i2c_bus_attach(s);
+}
+
+static void check(const char *name, int ok) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+    failed += !ok;
+}
+
+// bus ticks one transaction takes: START, address, reg, the written bytes, and for a read a
+// RESTART, address and the read bytes with their ACKs, then STOP
+static unsigned long ticks(int written, int read) {
+    return (1 + 9 + 9 + 9*written + (read ? 1 + 9 + 9*read : 0) + 1) * i2c_bus_bitTicks;
+}
+
+// a little over for the engine's core timer reads, but nowhere near a transaction it could
+// have waited behind
+static void checkTicks(const char *name, unsigned long got, unsigned long expected) {
+    char text[100];
+
+    sprintf(text, "%s bus time %lu ticks, its bits take %lu", name, got, expected);
+    check(text, got >= expected && got < expected + expected/50);
+}
+
+int main(void) {
+    I2C_SCHED_DEV *devs[3] = {&imu, &mag, &eep};
+    const char *names[3] = {"imu", "mag", "eep"};
+    unsigned int start, nextDrdy, nextOther;
+    unsigned int utilization, sum;
+    int i, ok = 1, readBack = 0;
+
+    i2c_bus_reset();
+    slave(&imuSlave, imu.address);
+    slave(&magSlave, mag.address);
+    slave(&eepSlave, eep.address);
+    slave(&otherSlave, 0x40);
+    i2c_engine_init(1);
+    i2c_engine_setSpeed(48000000, I2C_FAST);
+
+    // a tick per core timer read, so the loop adds little to what the engine times
+    host_coreStep = 1;
+    i2c_sched_init();
+    i2c_sched_addDevice(&imu);
+    i2c_sched_add(&eepWrite);
+    host_coreStep = 0; // due at the same count, so they always go in one burst
+    i2c_sched_add(&fieldJob);
+    i2c_sched_add(&statusJob);
+    host_coreStep = 1;
+    start = host_core;
+    nextDrdy = start;
+    nextOther = start;
+    while (host_core - start < TICKS_PER_SEC) {
+        if ((int)(host_core - nextDrdy) >= 0) {
+            nextDrdy += TICKS_PER_SEC/DRDY_HZ;
+            if (drdyTxn.status == I2C_PENDING) {
+                drdyMissed++;
+            } else {
+                i2c_engine_read(&drdyTxn, imu.address, 0x1E, drdyData, 18, 0);
+                drdyReads++;
+            }
+        }
+        if ((int)(host_core - nextOther) >= 0) {
+            nextOther += TICKS_PER_SEC/OTHER_HZ;
+            i2c_engine_read(&otherTxn, otherSlave.address, 0x00, otherData, 4, 0);
+            otherReads++;
+        }
+        if (!readBack && eepWrite.status == I2C_DONE && !eepWrite.queued) {
+            i2c_sched_add(&eepJob); // read back what was written
+            readBack = 1;
+        }
+        i2c_sched_tasks();
+        i2c_bus_step();
+        i2c_engine_tasks();
+    }
+    while (i2c_engine_busy()) {
+        i2c_bus_step();
+        i2c_engine_tasks();
+    }
+
+    for (i = 0; i < 6; i++) {
+        ok &= field[i] == (mag.address ^ (0x03 + i));
+    }
+    ok &= status[0] == (mag.address ^ 0x09);
+    ok &= eepRead[0] == 0x11 && eepRead[1] == 0x22;
+    check("jobs read and wrote the right registers", ok);
+    check("mag jobs merged into one burst", mag.transactions >= MAG_HZ && mag.transactions <= MAG_HZ + 1);
+
+    checkTicks("imu", imu.busTicks, imu.transactions * ticks(0, 18));
+    checkTicks("mag", mag.busTicks, mag.transactions * ticks(0, 7));
+    checkTicks("eep", eep.busTicks, ticks(2, 0) + ticks(0, 2));
+    check("imu counts its direct reads", imu.transactions == drdyReads && drdyReads > 0);
+
+    // the other device's reads are in the total but not in any device
+    utilization = i2c_sched_utilization(0);
+    sum = i2c_sched_utilization(&imu) + i2c_sched_utilization(&mag) + i2c_sched_utilization(&eep);
+    sum += (unsigned int)((unsigned long long)otherReads * ticks(0, 4) * 1000 / (host_core - start));
+    check("total covers every transaction", utilization + 3 >= sum && utilization <= sum + 3);
+
+    for (i = 0; i < 3; i++) {
+        printf("%s: transactions %lu, worst latency %u us, utilization %u/1000, errors %lu\n", names[i],
+            devs[i]->transactions, devs[i]->worstLatency / (TICKS_PER_SEC/1000000),
+            i2c_sched_utilization(devs[i]), devs[i]->errors);
+    }
+    printf("total utilization %u/1000, data ready reads %lu, missed %lu\n", utilization, drdyReads, drdyMissed);
+    printf("%d failed\n", failed);
+    return failed;
+}
@@ -0,0 +1,469 @@
+// run the drawing primitives of HW6's ILI9163C driver on the host against a stub SPI1 and print
+// what they send, and check the framebuffer's flushes.
+//
+//     cc -std=gnu99 -Ihost -I../HW6.X -DLCD_FRAMEBUFFER=0 -o lcd_bench lcd_bench.c host/regs.c
+//     cc -std=gnu99 -Ihost -I../HW6.X -DLCD_FRAMEBUFFER=1 -o lcd_bench_fb lcd_bench.c host/regs.c
+//
+// the driver is included whole, so its framebuffer and line buffers can be looked at. the stub
+// SPI1 is always ready, so nothing waits, and what a primitive costs is the bytes it sends,
+// counted by the driver in LCD_spiBytes. the table has the same primitives and repeats as
+// bench_primitives, with the pixels drawn, the bytes sent, and the pixels per second the SPI
+// clock allows for those bytes. that is an upper bound: the time the CPU takes between bytes,
+// and in byte mode the CS toggles and the wait for each byte to come back, are not in it.
+// bench_runPrimitives on the board measures the real rate.
+//
+// without the framebuffer, the byte and fifo bus modes are run. the DMA mode sends the same
+// bytes as the fifo mode, but it waits in LCD_wait for its interrupts, which the host cannot
+// run while the driver is waiting, so it has no row in the table and is only timed on the
+// board. what it sends is checked below.
+//
+// with the framebuffer, every flush goes through the DMA path, with the DMA and spi1
+// interrupts run by hand here for each row. the rows are written into a model of the LCD's
+// memory, and after each test flush the model has to match the framebuffer everywhere, so
+// nothing drawn was left out of the dirty rectangles. the bytes of a flush are checked to be
+// only those of its dirty rectangles.
+//
+// both builds then run the DMA path against a stub of the hardware, a word at a time: spi1's
+// 8 word tx fifo and shift register, and DMA channel 0 moving a cell from its source into the
+// fifo on each trigger. the trigger is the tx interrupt event, which comes when a word leaves
+// the fifo for the shift register and there is room, and is lost if the channel is not enabled
+// then, as on the chip. a forced cell moves one at once. the DMA and spi1 interrupts run a set
+// number of word times after their flag goes up, from 0 to longer than the fifo takes to
+// drain, so a row can be started with the fifo full, part full, empty with the last word
+// still shifting, or idle. the words that reach the wire have to be the fill, the buffer
+// given to LCD_writePixels, or the flushed rectangles out of the framebuffer, with nothing
+// lost, repeated or stalled. the exit status is the number of checks that failed
+
+#include <stdio.h>
+#include <string.h>
+#include "ILI9163C.c"
+
+#define PBCLK 48000000
+#define REPS 20 // as in bench_primitives
+#define PRIMS 7
+
+static const char *names[PRIMS] = {"pixel", "fillRect", "hline", "vline", "line", "circle", "fillCirc"};
+static int failed;
+
+static void check(const char *name, int ok) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+    failed += !ok;
+}
+
+// a stub SPI1 that has always sent everything and has room for more
+static void spiReady(void) {
+    SPI1STATbits.SPIRBF = 1;
+    SPI1STATbits.SPIRBE = 1;
+    SPI1STATbits.SPITBE = 1;
+    SPI1STATbits.SPITBF = 0;
+    SPI1STATbits.SPIBUSY = 0;
+}
+
+#if LCD_FRAMEBUFFER
+static unsigned short panel[_GRAMHEIGH][_GRAMWIDTH]; // what the LCD would show
+
+// run the DMA and spi1 interrupts until the transfer is done. each row the DMA was given is
+// written into the panel: it is row y1 - dmaRows of the rectangle being flushed
+static void pump(void) {
+    LCD_RECT *r;
+    const unsigned short *row;
+    unsigned short y, i;
+
+    while (LCD_busy()) {
+        if (DCH0CONbits.CHEN) {
+            r = &flushRects[flushIndex];
+            row = DCH0SSA == KVA_TO_PA(lineBuf[0]) ? lineBuf[0] : lineBuf[1];
+            y = r->y1 - dmaRows;
+            for (i = 0; i < DCH0SSIZ/2; i++) {
+                panel[y][r->x0 + i] = row[i];
+            }
+            DCH0CONbits.CHEN = 0;
+            DMA0ISR();
+        } else if (IEC1bits.SPI1TXIE && IFS1bits.SPI1TXIF) {
+            SPI1ISR();
+        } else {
+            printf("the transfer stopped with nothing to do\n");
+            failed++;
+            return;
+        }
+    }
+}
+
+static void flush(void) {
+    LCD_flushAsync(0);
+    pump();
+}
+
+// pixels where the panel is not what the framebuffer has
+static int panelWrong(void) {
+    int x, y, wrong = 0;
+    unsigned char b;
+
+    for (y = 0; y < _GRAMHEIGH; y++) {
+        for (x = 0; x < _GRAMWIDTH; x++) {
+            b = framebuffer[(y*_GRAMWIDTH + x) >> 1];
+            wrong += panel[y][x] != palette[(x & 1) ? (b >> 4) : (b & 0x0F)];
+        }
+    }
+    return wrong;
+}
+
+// bytes to set the window of a flush rectangle
+static unsigned long addrBytes(void) {
+    unsigned long bytes;
+
+    LCD_drawPixel(0, 0, RED);
+    LCD_spiBytes = 0;
+    flush();
+    bytes = LCD_spiBytes - 2;
+    return bytes;
+}
+
+static void flushes(void) {
+    unsigned long addr, bytes;
+    char name[80];
+
+    memset(panel, 0xAA, sizeof(panel));
+    LCD_clearScreen(BLACK);
+    flush();
+    addr = addrBytes();
+    check("a full clear and flush fills the panel", panelWrong() == 0);
+
+    LCD_spiBytes = 0;
+    flush();
+    check("a flush with nothing drawn sends nothing", LCD_spiBytes == 0);
+
+    // two rectangles apart are sent as two windows
+    LCD_spiBytes = 0;
+    LCD_fillRect(10, 10, 20, 5, RED);
+    LCD_fillRect(90, 100, 8, 8, GREEN);
+    flush();
+    bytes = 2*addr + 2*(20*5 + 8*8);
+    sprintf(name, "two rectangles send only their pixels, %lu bytes for %lu", LCD_spiBytes, bytes);
+    check(name, LCD_spiBytes == bytes && panelWrong() == 0);
+
+    // ones that touch are merged into one window
+    LCD_spiBytes = 0;
+    LCD_fillRect(40, 40, 10, 10, BLUE);
+    LCD_fillRect(50, 40, 10, 10, YELLOW);
+    flush();
+    bytes = addr + 2*(20*10);
+    sprintf(name, "touching rectangles send one window, %lu bytes for %lu", LCD_spiBytes, bytes);
+    check(name, LCD_spiBytes == bytes && panelWrong() == 0);
+
+    // more than LCD_DIRTY_MAX areas are merged into the ones that grow least, nothing is lost
+    LCD_drawString(0, 0, "merged");
+    LCD_drawLine(0, 127, 127, 60, CYAN);
+    LCD_drawCircle(64, 64, 30, MAGENTA);
+    LCD_fillCircle(100, 30, 12, WHITE);
+    LCD_drawPixel(127, 127, RED);
+    LCD_vline(5, 20, 90, GREEN);
+    LCD_hline(20, 120, 100, YELLOW);
+    LCD_drawString(60, 110, "x");
+    LCD_fillRect(110, 90, 5, 5, BLUE);
+    flush();
+    check("many areas flush to what was drawn", panelWrong() == 0);
+}
+#endif
+
+// the stub hardware
+#define FIFO_WORDS 8
+#define WIRE_MAX (_GRAMWIDTH * _GRAMHEIGH * 2)
+
+static unsigned short fifo[FIFO_WORDS];
+static int fifoCount, fifoHead, shifting, overflows;
+static const unsigned short *dmaSource, *dmaUser; // where the channel reads, a buffer given to LCD_writePixels
+static int dmaRunning, dmaLeft; // cells left in the block
+static int dmaWait, spiWait; // word times an interrupt flag has been up
+static unsigned short wire[WIRE_MAX]; // words that were shifted out
+static long wireCount;
+
+static void stubReset(void) {
+    fifoCount = fifoHead = shifting = overflows = 0;
+    dmaRunning = dmaLeft = dmaWait = spiWait = 0;
+    wireCount = 0;
+    DCH0CONbits.CHEN = 0;
+    IFS1bits.DMA0IF = 0;
+    IFS1bits.SPI1TXIF = 0;
+}
+
+static void stubStatus(void) {
+    SPI1STATbits.SPITBE = fifoCount == 0;
+    SPI1STATbits.SPITBF = fifoCount == FIFO_WORDS;
+    SPI1STATbits.SPIBUSY = shifting;
+    SPI1STATbits.SPIRBF = 1; // spi_io's bytes are not modeled, they go at once
+    SPI1STATbits.SPIRBE = 1;
+    if (SPI1CONbits.STXISEL == 0 && fifoCount == 0 && !shifting) {
+        IFS1bits.SPI1TXIF = 1; // all sent
+    }
+}
+
+// one cell, a word from the source into the fifo, and the block interrupt after the last
+static void stubCell(void) {
+    if (!dmaRunning) {
+        return;
+    }
+    if (fifoCount == FIFO_WORDS) {
+        overflows++;
+    } else {
+        fifo[(fifoHead + fifoCount++) % FIFO_WORDS] = *dmaSource;
+    }
+    dmaSource++;
+    if (--dmaLeft == 0) {
+        dmaRunning = 0;
+        DCH0CONbits.CHEN = 0;
+        IFS1bits.DMA0IF = 1;
+    }
+    stubStatus();
+}
+
+// after the driver ran: a channel it enabled starts from DCH0SSA, and a forced cell goes now
+static void stubNotice(void) {
+    if (DCH0CONbits.CHEN && !dmaRunning) {
+        dmaRunning = 1;
+        dmaLeft = DCH0SSIZ / 2;
+        dmaSource = DCH0SSA == KVA_TO_PA(lineBuf[0]) ? lineBuf[0]
+            : DCH0SSA == KVA_TO_PA(lineBuf[1]) ? lineBuf[1] : dmaUser;
+    }
+    stubStatus();
+    if (DCH0ECONbits.CFORCE) {
+        DCH0ECONbits.CFORCE = 0;
+        stubCell();
+    }
+}
+
+// a transfer that stalled is dropped, so the driver does not wait on it forever
+static void stubAbort(void) {
+    fifoCount = shifting = dmaRunning = 0;
+    DCH0CONbits.CHEN = 0;
+    IEC1bits.DMA0IE = 0;
+    IEC1bits.SPI1TXIE = 0;
+    stubStatus();
+    LCD_dmaFinish();
+#if LCD_FRAMEBUFFER
+    flushCount = 0;
+#endif
+    dmaDone = 0;
+    dmaBusy = 0;
+}
+
+// run word times until the transfer is done, with the interrupts latency word times late.
+// 0 if it stopped with words still to go
+static int stubRun(int latency) {
+    long idle = 0;
+
+    stubNotice();
+    while (LCD_busy()) {
+        if (shifting) { // the word in the shift register is out
+            shifting = 0;
+        }
+        if (fifoCount) { // the next one goes in, and the room it leaves is a trigger
+            if (wireCount < WIRE_MAX) {
+                wire[wireCount] = fifo[fifoHead];
+            }
+            wireCount++;
+            fifoHead = (fifoHead + 1) % FIFO_WORDS;
+            fifoCount--;
+            shifting = 1;
+            stubStatus();
+            stubCell();
+            idle = 0;
+        }
+        stubStatus();
+        if (IEC1bits.DMA0IE && IFS1bits.DMA0IF && ++dmaWait > latency) {
+            dmaWait = 0;
+            DMA0ISR();
+            stubNotice();
+            idle = 0;
+        }
+        if (IEC1bits.SPI1TXIE && IFS1bits.SPI1TXIF && ++spiWait > latency) {
+            spiWait = 0;
+            SPI1ISR();
+            stubNotice();
+            idle = 0;
+        }
+        if (++idle > latency + 100) {
+            stubAbort();
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static const int latencies[] = {0, 1, 3, 7, 8, 9, 20};
+#define LATENCIES (int)(sizeof(latencies)/sizeof(latencies[0]))
+
+// wire words from start that are not want, -1 if the count is wrong
+static long wireWrong(long start, const unsigned short *want, long count, unsigned short fill) {
+    long i, wrong = 0;
+
+    if (wireCount - start != count) {
+        return -1;
+    }
+    for (i = 0; i < count && start + i < WIRE_MAX; i++) {
+        wrong += wire[start + i] != (want ? want[i] : fill);
+    }
+    return wrong;
+}
+
+#if LCD_FRAMEBUFFER
+static unsigned short flushWant[WIRE_MAX];
+
+// every dirty rectangle, row by row out of the framebuffer, through the stub
+static void stubFlushes(void) {
+    static const unsigned short rects[][4] = {{10, 10, 20, 5}, {90, 100, 8, 8}, {0, 127, 128, 1}, {127, 0, 1, 100}, {40, 40, 33, 17}};
+    char name[160];
+    int l, k, j, ok;
+    long count, wrong;
+    unsigned short x, y;
+    unsigned char b;
+
+    for (l = 0; l < LATENCIES; l++) {
+        ok = 1;
+        LCD_clearScreen(BLACK); // a whole screen first, then only the rectangles are dirty
+        stubReset();
+        LCD_flushAsync(0);
+        ok &= stubRun(latencies[l]);
+        for (k = 0; k < (int)(sizeof(rects)/sizeof(rects[0])); k++) {
+            LCD_fillRect(rects[k][0], rects[k][1], rects[k][2], rects[k][3], k & 1 ? RED : CYAN);
+        }
+        LCD_drawString(20, 60, "dma");
+        stubReset();
+        LCD_flushAsync(0);
+        count = 0;
+        for (j = 0; j < flushCount; j++) {
+            for (y = flushRects[j].y0; y <= flushRects[j].y1; y++) {
+                for (x = flushRects[j].x0; x <= flushRects[j].x1; x++) {
+                    b = framebuffer[(y*_GRAMWIDTH + x) >> 1];
+                    flushWant[count++] = palette[(x & 1) ? (b >> 4) : (b & 0x0F)];
+                }
+            }
+        }
+        ok &= stubRun(latencies[l]);
+        wrong = wireWrong(0, flushWant, count, 0);
+        sprintf(name, "dma flush of %d rectangles with the interrupts %d word times late, %ld of %ld words wrong, %d overflows",
+            j, latencies[l], wrong, count, overflows);
+        check(name, ok && wrong == 0 && overflows == 0);
+    }
+}
+#else
+static int doneCalls;
+
+static void done(void) {
+    doneCalls++;
+}
+
+// fills and LCD_writePixels in DMA mode through the stub
+static void stubFills(void) {
+    static const unsigned short rects[][4] = {{0, 0, 128, 128}, {10, 10, 20, 5}, {3, 7, 1, 40}, {0, 127, 128, 1}, {40, 40, 33, 17}};
+    static unsigned short pixels[1000];
+    char name[160];
+    int l, k, i, ok;
+    long start, wrong;
+
+    for (i = 0; i < 1000; i++) {
+        pixels[i] = (unsigned short)(i * 40503u);
+    }
+    for (l = 0; l < LATENCIES; l++) {
+        ok = 1;
+        wrong = 0;
+        stubReset();
+        for (k = 0; k < (int)(sizeof(rects)/sizeof(rects[0])); k++) {
+            start = wireCount;
+            LCD_fillRect(rects[k][0], rects[k][1], rects[k][2], rects[k][3], 0x1234 + k);
+            ok &= stubRun(latencies[l]);
+            i = wireWrong(start, 0, (long)rects[k][2] * rects[k][3], 0x1234 + k);
+            wrong += i < 0 ? 1 : i;
+        }
+        start = wireCount;
+        doneCalls = 0;
+        dmaUser = pixels;
+        LCD_setAddr(0, 0, 99, 9);
+        LCD_writePixels(pixels, 1000, done);
+        ok &= stubRun(latencies[l]);
+        i = wireWrong(start, pixels, 1000, 0);
+        wrong += i < 0 ? 1 : i;
+        sprintf(name, "dma fills and LCD_writePixels with the interrupts %d word times late, %ld wrong, %d overflows",
+            latencies[l], wrong, overflows);
+        check(name, ok && wrong == 0 && overflows == 0 && doneCalls == 1 && !SPI1CONbits.MODE16 && LATBbits.LATB7);
+    }
+}
+#endif
+
+static void primitives(const char *mode) {
+    unsigned long pixels, bytes, sck = PBCLK / (2*(SPI1BRG + 1));
+    int prim, i;
+
+    printf("%s, SPI clock %lu Hz\n", mode, sck);
+    printf("%-9s %8s %9s %11s %15s\n", "", "pixels", "SPI bytes", "bytes/pixel", "pixels/s bound");
+    for (prim = 0; prim < PRIMS; prim++) {
+        LCD_clearScreen(BLACK);
+#if LCD_FRAMEBUFFER
+        flush();
+#endif
+        LCD_pixels = 0;
+        LCD_spiBytes = 0;
+        for (i = 0; i < REPS; i++) {
+            unsigned short color = i & 1 ? YELLOW : CYAN;
+            switch (prim) {
+                case 0: // a 10x10 square one pixel at a time, for comparison
+                    {
+                        unsigned short x, y;
+                        for (y = 0; y < 10; y++) {
+                            for (x = 0; x < 10; x++) {
+                                LCD_drawPixel(40 + x, 40 + y, color);
+                            }
+                        }
+                        LCD_pixels += 100;
+                    }
+                    break;
+                case 1:
+                    LCD_fillRect(20, 20, 80, 80, color);
+                    break;
+                case 2:
+                    LCD_hline(4, 64, 120, color);
+                    break;
+                case 3:
+                    LCD_vline(64, 4, 120, color);
+                    break;
+                case 4:
+                    LCD_drawLine(0, 10, 127, 117, color);
+                    break;
+                case 5:
+                    LCD_drawCircle(64, 64, 50, color);
+                    break;
+                case 6:
+                    LCD_fillCircle(64, 64, 40, color);
+                    break;
+            }
+        }
+#if LCD_FRAMEBUFFER
+        flush();
+#endif
+        pixels = LCD_pixels;
+        bytes = LCD_spiBytes;
+        printf("%-9s %8lu %9lu %11.2f %15.0f\n", names[prim], pixels, bytes, (double)bytes / pixels,
+            bytes ? (double)pixels * sck / (8.0 * bytes) : 0.0);
+    }
+    printf("\n");
+}
+
+int main(void) {
+    spiReady();
+#if LCD_FRAMEBUFFER
+    SPI1_init(LCD_BUS_DMA);
+    flushes();
+    printf("\n");
+    primitives("framebuffer, flushed once after the repeats");
+    stubFlushes();
+#else
+    SPI1_init(LCD_BUS_BYTE);
+    primitives("byte mode");
+    SPI1_init(LCD_BUS_FIFO);
+    primitives("fifo mode, and the bytes of dma mode");
+    SPI1_init(LCD_BUS_DMA);
+    stubFills();
+#endif
+    printf("%d failed\n", failed);
+    return failed;
+}
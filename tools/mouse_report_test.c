@@ -0,0 +1,121 @@
+// check the mouse report packer and the fraction carry in HW7's mouse.c on the host, for both
+// report formats.
+//
+//     cc -std=gnu99 -Ihost/harmony -I../HW7/hid_mouse/firmware/src -DMOUSE_HIGH_RES=1 -o mouse_report_test mouse_report_test.c ../HW7/hid_mouse/firmware/src/mouse.c
+//     ./mouse_report_test
+//
+// and again with -DMOUSE_HIGH_RES=0 for the 3 byte report. the report bytes are compared with
+// the layout hid_rpt0 in system_init.c declares, and MOUSE_MotionTake is fed slow,
+// alternating, random and too fast motion to check no fraction of a count is lost or made up
+// below the saturation. the exit status is the number of checks that failed
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "mouse.h"
+
+static int failed;
+
+static void check(const char *name, int ok) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+    failed += !ok;
+}
+
+static int bytes(const MOUSE_REPORT *r, const unsigned char *want, int n) {
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (r->data[i] != want[i]) {
+            printf("     byte %d is %02X, not %02X\n", i, r->data[i], want[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void report(void) {
+    MOUSE_BUTTON_STATE left[MOUSE_BUTTON_NUMBERS] = {MOUSE_BUTTON_STATE_PRESSED, MOUSE_BUTTON_STATE_RELEASED};
+    MOUSE_BUTTON_STATE both[MOUSE_BUTTON_NUMBERS] = {MOUSE_BUTTON_STATE_PRESSED, MOUSE_BUTTON_STATE_PRESSED};
+    MOUSE_REPORT r;
+#if MOUSE_HIGH_RES
+    const unsigned char small[6] = {0x01, 0xFE, 0xFF, 0x2C, 0x01, 0xFF};
+    const unsigned char extremes[6] = {0x03, 0x01, 0x80, 0xFF, 0x7F, 0x00};
+
+    check("report is 6 bytes", sizeof(r) == 6);
+    MOUSE_ReportCreate(-2, 300, -1, left, &r);
+    check("buttons, 16 bit x and y low byte first, wheel", bytes(&r, small, 6));
+    MOUSE_ReportCreate(-32767, 32767, 0, both, &r);
+    check("x and y at the ends of the range", bytes(&r, extremes, 6));
+#else
+    const unsigned char small[3] = {0x01, 0xFE, 0x64};
+    const unsigned char extremes[3] = {0x03, 0x81, 0x7F};
+
+    check("report is 3 bytes", sizeof(r) == 3);
+    MOUSE_ReportCreate(-2, 100, -1, left, &r);
+    check("buttons, 8 bit x and y, no wheel", bytes(&r, small, 3));
+    MOUSE_ReportCreate(-127, 127, 0, both, &r);
+    check("x and y at the ends of the range", bytes(&r, extremes, 3));
+#endif
+}
+
+// every 1/256 count that goes in comes out as counts or is still in the residue
+static int kept(const MOUSE_ACCUMULATOR *a, long in, long out) {
+    return in == out * MOUSE_MOTION_ONE + a->residue
+        && a->residue > -MOUSE_MOTION_ONE && a->residue < MOUSE_MOTION_ONE;
+}
+
+static void carry(void) {
+    MOUSE_ACCUMULATOR a = {0};
+    MOUSE_COORDINATE c;
+    long in = 0, out = 0;
+    int i, moved = 0, ok = 1;
+
+    // a tenth of a count a report still moves, a count every ten or so reports
+    for (i = 0; i < 1000; i++) {
+        c = MOUSE_MotionTake(&a, 26);
+        moved += c != 0;
+        out += c;
+    }
+    check("a tenth of a count a report moves", out == 1000*26/256 && moved == out && kept(&a, 1000*26, out));
+
+    a.residue = 0;
+    out = 0;
+    for (i = 0; i < 1000; i++) {
+        out += MOUSE_MotionTake(&a, -26);
+    }
+    check("and backwards the same", out == -(1000*26/256) && kept(&a, -1000*26, out));
+
+    // jitter around zero does not creep in either direction
+    a.residue = 0;
+    out = 0;
+    for (i = 0; i < 1000; i++) {
+        out += MOUSE_MotionTake(&a, i & 1 ? -200 : 200);
+    }
+    check("jitter around zero adds up to nothing", out == 0 && a.residue == 0);
+
+    a.residue = 0;
+    out = 0;
+    srand(1);
+    for (i = 0; i < 100000; i++) {
+        long m = rand() % (40 * MOUSE_MOTION_ONE) - 20 * MOUSE_MOTION_ONE;
+
+        in += m;
+        out += MOUSE_MotionTake(&a, m);
+        ok &= kept(&a, in, out);
+    }
+    check("random motion loses nothing", ok);
+
+    // past the range the report is full and the excess is dropped, the fraction is kept
+    a.residue = 0;
+    c = MOUSE_MotionTake(&a, (long)(MOUSE_COORDINATE_MAX + 50) * MOUSE_MOTION_ONE + 100);
+    check("too fast saturates and keeps the fraction", c == MOUSE_COORDINATE_MAX && a.residue == 100);
+    c = MOUSE_MotionTake(&a, -(long)(MOUSE_COORDINATE_MAX + 50) * MOUSE_MOTION_ONE);
+    check("and the other way", c == -MOUSE_COORDINATE_MAX && a.residue > -MOUSE_MOTION_ONE && a.residue < MOUSE_MOTION_ONE);
+}
+
+int main(void) {
+    printf("MOUSE_HIGH_RES %d\n", MOUSE_HIGH_RES);
+    report();
+    carry();
+    printf("%d failed\n", failed);
+    return failed;
+}
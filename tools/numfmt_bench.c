@@ -0,0 +1,191 @@
+// check common/numfmt.c against snprintf on the host and time both.
+//
+//     cc -std=gnu99 -O2 -I../common -o numfmt_bench numfmt_bench.c ../common/numfmt.c
+//     ./numfmt_bench
+//
+// fmt_fixed, fmt_int and fmt_uint are run over edge values (0, +-1, carries like 99 and 100, and
+// LONG_MIN and LONG_MAX of the host) with every number of decimals, a few widths, and the
+// plus, zero and left flags, and the text has to be what snprintf("%.*f") makes of
+// value/10^decimals with the same width and flags. where a double cannot hold the value
+// exactly the digits of snprintf("%lu") with the point put in are used instead. the buffer
+// is only as long as the header says it has to be, with a guard byte after it. fmt_uint has to
+// match snprintf("%lu") up to ULONG_MAX.
+//
+// then "%.2f" of a reading is timed both ways, in ns per call. on the board bench_format
+// counts the cycles. the exit status is the number of checks that failed
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "numfmt.h"
+
+#define CALLS 2000000
+#define EXACT 1000000000000000L // a double holds every long up to this exactly
+#define GUARD 0x5A
+
+static const char zeros[] = "000000000000000000000000000000";
+
+static const long values[] = {
+    0, 1, -1, 5, -5, 9, -9, 10, 99, -99, 100, 101, 999, 1000, 12345, -12345, 1999999999,
+    2147483647L, -2147483647L - 1, 1000000000, -1000000000, LONG_MAX, LONG_MIN, LONG_MIN + 1,
+};
+static const unsigned long unsignedValues[] = {
+    0, 1, 9, 10, 4294967295UL, (unsigned long)LONG_MAX + 1, ULONG_MAX - 1, ULONG_MAX,
+};
+static const unsigned char widths[] = {0, 1, 5, 12, 25};
+static const unsigned char flagSets[] = {
+    0, FMT_PLUS, FMT_ZERO, FMT_LEFT, FMT_PLUS | FMT_ZERO, FMT_PLUS | FMT_LEFT, FMT_ZERO | FMT_LEFT,
+};
+static int failed;
+
+// the digits of v with a point before the last decimals, at least one before it
+static void digits(char *out, unsigned long v, int decimals) {
+    char d[40];
+    int n, lead;
+
+    n = snprintf(d, sizeof(d), "%lu", v);
+    lead = n > decimals ? n - decimals : 0;
+    if (lead == 0) {
+        out += sprintf(out, "0");
+    }
+    out += sprintf(out, "%.*s", lead, d);
+    if (decimals) {
+        sprintf(out, ".%.*s%s", decimals - (n - lead), zeros, d + lead);
+    }
+}
+
+// what printf makes of value/10^decimals
+static void reference(char *out, int size, long value, int decimals, int width, int flags) {
+    char format[16], *f = format, number[48], sign[2] = {0, 0};
+    double scale = 1;
+    int i, n, pad;
+
+    if (value > -EXACT && value < EXACT) {
+        *f++ = '%';
+        if (flags & FMT_PLUS) {
+            *f++ = '+';
+        }
+        if (flags & FMT_LEFT) {
+            *f++ = '-';
+        } else if (flags & FMT_ZERO) {
+            *f++ = '0';
+        }
+        strcpy(f, "*.*f");
+        for (i = 0; i < decimals; i++) {
+            scale *= 10;
+        }
+        snprintf(out, size, format, width, decimals, value / scale);
+        return;
+    }
+
+    // too long for a double, the same layout by hand
+    if (value < 0) {
+        sign[0] = '-';
+    } else if (flags & FMT_PLUS) {
+        sign[0] = '+';
+    }
+    digits(number, value < 0 ? -(unsigned long)value : (unsigned long)value, decimals);
+    n = strlen(sign) + strlen(number);
+    pad = width > n ? width - n : 0;
+    if (flags & FMT_LEFT) {
+        snprintf(out, size, "%s%s%*s", sign, number, pad, "");
+    } else if (flags & FMT_ZERO) {
+        snprintf(out, size, "%s%.*s%s", sign, pad, zeros, number);
+    } else {
+        snprintf(out, size, "%*s%s%s", pad, "", sign, number);
+    }
+}
+
+static void compare(void) {
+    char buf[96], want[96];
+    unsigned int v, d, w, f, cases = 0, wrong = 0;
+    int n, size;
+
+    for (v = 0; v < sizeof(values)/sizeof(values[0]); v++) {
+        for (d = 0; d <= 9; d++) {
+            for (w = 0; w < sizeof(widths); w++) {
+                for (f = 0; f < sizeof(flagSets); f++) {
+                    size = widths[w] + 1 > FMT_MAX ? widths[w] + 1 : FMT_MAX;
+                    memset(buf, GUARD, sizeof(buf));
+                    n = d ? fmt_fixed(buf, values[v], d, widths[w], flagSets[f])
+                          : fmt_int(buf, values[v], widths[w], flagSets[f]);
+                    reference(want, sizeof(want), values[v], d, widths[w], flagSets[f]);
+                    cases++;
+                    if (strcmp(buf, want) != 0 || n != (int)strlen(want) || buf[size] != GUARD) {
+                        if (wrong++ < 10) {
+                            printf("     %ld, %u decimals, width %u, flags %u: \"%s\", not \"%s\"%s\n",
+                                values[v], d, widths[w], flagSets[f], buf, want,
+                                buf[size] != GUARD ? ", past the end of the buffer" : "");
+                        }
+                    }
+                }
+            }
+        }
+    }
+    printf("%s %u cases match snprintf, %u wrong\n", wrong ? "FAIL" : "ok  ", cases, wrong);
+    failed += wrong != 0;
+}
+
+static void compareUnsigned(void) {
+    char buf[96], want[96], format[16];
+    unsigned int v, w, f, cases = 0, wrong = 0;
+    int n, size;
+
+    for (v = 0; v < sizeof(unsignedValues)/sizeof(unsignedValues[0]); v++) {
+        for (w = 0; w < sizeof(widths); w++) {
+            for (f = 0; f < sizeof(flagSets); f++) {
+                size = widths[w] + 1 > FMT_MAX ? widths[w] + 1 : FMT_MAX;
+                memset(buf, GUARD, sizeof(buf));
+                n = fmt_uint(buf, unsignedValues[v], widths[w], flagSets[f] & ~FMT_PLUS);
+                strcpy(format, flagSets[f] & FMT_LEFT ? "%-*lu" : flagSets[f] & FMT_ZERO ? "%0*lu" : "%*lu");
+                snprintf(want, sizeof(want), format, widths[w], unsignedValues[v]);
+                cases++;
+                if (strcmp(buf, want) != 0 || n != (int)strlen(want) || buf[size] != GUARD) {
+                    if (wrong++ < 10) {
+                        printf("     %lu, width %u, flags %u: \"%s\", not \"%s\"\n",
+                            unsignedValues[v], widths[w], flagSets[f], buf, want);
+                    }
+                }
+            }
+        }
+    }
+    printf("%s %u unsigned cases match snprintf, %u wrong\n", wrong ? "FAIL" : "ok  ", cases, wrong);
+    failed += wrong != 0;
+}
+
+static double seconds(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// "%.2f" of readings like the IMU's, in hundredths
+static void timing(void) {
+    char buf[64];
+    volatile unsigned long sink = 0;
+    double start, printfNs, fmtNs;
+    long i;
+
+    start = seconds();
+    for (i = 0; i < CALLS; i++) {
+        sink += snprintf(buf, sizeof(buf), "%.2f", (i % 40000 - 20000) / 100.0);
+    }
+    printfNs = (seconds() - start) * 1e9 / CALLS;
+    start = seconds();
+    for (i = 0; i < CALLS; i++) {
+        sink += fmt_fixed(buf, i % 40000 - 20000, 2, 0, 0);
+    }
+    fmtNs = (seconds() - start) * 1e9 / CALLS;
+    printf("\"%%.2f\" of a reading: snprintf %.1f ns, fmt_fixed %.1f ns a call\n", printfNs, fmtNs);
+}
+
+int main(void) {
+    printf("long is %u bits, FMT_MAX %u\n", (unsigned)(sizeof(long) * 8), (unsigned)FMT_MAX);
+    compare();
+    compareUnsigned();
+    timing();
+    printf("%d failed\n", failed);
+    return failed;
+}
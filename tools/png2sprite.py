@@ -0,0 +1,182 @@
+#!/usr/bin/env python
+"""Convert PNG images into run-length encoded LCD_SPRITE tables for the ILI9163C driver.
+
+    python png2sprite.py <out> <image.png> [<image.png> ...]
+
+writes <out>.c and <out>.h with one "const LCD_SPRITE sprite_<name>" per image, named
+after the file. Each image may use up to 16 colors (alpha is ignored). The pixels are
+stored left to right, top to bottom, as runs of one palette color:
+
+    one byte  nnnn cccc      run of n+1 pixels (1..15) of palette color c
+              1111 cccc, m   run of 16+m pixels (16..271)
+
+Only the standard library is used, so it runs anywhere the MPLAB X make does.
+HW6.X runs it with 'make sprites', builds use the checked in output.
+"""
+
+import os
+import re
+import struct
+import sys
+import zlib
+
+MAX_COLORS = 16
+MAX_SIZE = 128  # the LCD is 128x128, width and height are stored in a byte
+
+
+def read_png(path):
+    """Return (width, height, rows of (r, g, b) tuples) for a non-interlaced PNG."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:8] != b'\x89PNG\r\n\x1a\n':
+        raise ValueError('%s is not a PNG' % path)
+
+    pos = 8
+    idat = b''
+    plte = []
+    while pos < len(data):
+        length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b'IHDR':
+            width, height, depth, ctype, _, _, interlace = struct.unpack('>IIBBBBB', body)
+        elif kind == b'PLTE':
+            plte = [tuple(body[i:i + 3]) for i in range(0, len(body), 3)]
+        elif kind == b'IDAT':
+            idat += body
+        elif kind == b'IEND':
+            break
+
+    if interlace:
+        raise ValueError('%s: interlaced PNGs are not supported' % path)
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[ctype]
+    if depth > 8 or (depth != 8 and ctype not in (0, 3)):
+        raise ValueError('%s: only 8 bit RGB/RGBA/gray images are supported' % path)
+
+    bits = channels * depth
+    stride = (width * bits + 7) // 8
+    bpp = max(1, bits // 8)  # bytes per pixel for the filters
+    raw = zlib.decompress(idat)
+    rows = []
+    prev = bytearray(stride)
+    for y in range(height):
+        start = y * (stride + 1)
+        kind = raw[start]
+        line = bytearray(raw[start + 1:start + 1 + stride])
+        for i in range(stride):
+            a = line[i - bpp] if i >= bpp else 0
+            b = prev[i]
+            c = prev[i - bpp] if i >= bpp else 0
+            if kind == 1:
+                line[i] = (line[i] + a) & 0xFF
+            elif kind == 2:
+                line[i] = (line[i] + b) & 0xFF
+            elif kind == 3:
+                line[i] = (line[i] + ((a + b) >> 1)) & 0xFF
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                pred = a if pa <= pb and pa <= pc else (b if pb <= pc else c)
+                line[i] = (line[i] + pred) & 0xFF
+        prev = line
+
+        pixels = []
+        for x in range(width):
+            if depth < 8:
+                bit = x * depth
+                v = (line[bit // 8] >> (8 - depth - bit % 8)) & ((1 << depth) - 1)
+                if ctype == 0:
+                    v = v * 255 // ((1 << depth) - 1)
+            else:
+                v = None
+                px = line[x * channels:(x + 1) * channels]
+            if ctype == 3:
+                pixels.append(plte[v if depth < 8 else px[0]])
+            elif ctype in (0, 4):
+                g = v if depth < 8 else px[0]
+                pixels.append((g, g, g))
+            else:
+                pixels.append(tuple(px[:3]))
+        rows.append(pixels)
+    return width, height, rows
+
+
+def rgb565(rgb):
+    r, g, b = rgb
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)
+
+
+def encode(path):
+    width, height, rows = read_png(path)
+    if width > MAX_SIZE or height > MAX_SIZE:
+        raise ValueError('%s is %dx%d, larger than the LCD' % (path, width, height))
+
+    palette = []
+    pixels = []
+    for row in rows:
+        for rgb in row:
+            color = rgb565(rgb)
+            if color not in palette:
+                palette.append(color)
+                if len(palette) > MAX_COLORS:
+                    raise ValueError('%s has more than %d colors' % (path, MAX_COLORS))
+            pixels.append(palette.index(color))
+
+    data = bytearray()
+    i = 0
+    while i < len(pixels):
+        c = pixels[i]
+        n = 1
+        while i + n < len(pixels) and pixels[i + n] == c and n < 16 + 255:
+            n += 1
+        if n < 16:
+            data.append(((n - 1) << 4) | c)
+        else:
+            data.append(0xF0 | c)
+            data.append(n - 16)
+        i += n
+    return width, height, palette, data
+
+
+def c_name(path):
+    return re.sub(r'\W', '_', os.path.splitext(os.path.basename(path))[0])
+
+
+def main(argv):
+    if len(argv) < 3:
+        sys.stderr.write(__doc__)
+        return 1
+    out = argv[1]
+    guard = re.sub(r'\W', '_', os.path.basename(out)).upper() + '_H__'
+    header = os.path.basename(out) + '.h'
+
+    h = ['// generated by tools/png2sprite.py, do not edit', '',
+         '#ifndef ' + guard, '#define ' + guard, '', '#include "ILI9163C.h"', '']
+    c = ['// generated by tools/png2sprite.py, do not edit', '',
+         '#include "%s"' % header]
+    for path in argv[2:]:
+        name = c_name(path)
+        width, height, palette, data = encode(path)
+        h.append('extern const LCD_SPRITE sprite_%s; // %dx%d, %d colors, %d bytes'
+                 % (name, width, height, len(palette), len(data)))
+        c.append('')
+        c.append('static const unsigned short %s_palette[%d] = {' % (name, len(palette)))
+        c.append('    ' + ','.join('0x%04X' % p for p in palette))
+        c.append('};')
+        c.append('static const unsigned char %s_data[%d] = {' % (name, len(data)))
+        for i in range(0, len(data), 16):
+            c.append('    ' + ','.join('0x%02X' % b for b in data[i:i + 16]) + ',')
+        c.append('};')
+        c.append('const LCD_SPRITE sprite_%s = {%d, %d, %d, %s_palette, %s_data};'
+                 % (name, width, height, len(palette), name, name))
+    h += ['', '#endif']
+
+    with open(out + '.h', 'w') as f:
+        f.write('\n'.join(h) + '\n')
+    with open(out + '.c', 'w') as f:
+        f.write('\n'.join(c) + '\n')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
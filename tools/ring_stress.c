@@ -0,0 +1,97 @@
+// stress the single producer, single consumer ring in common/ring.c from two threads on the host.
+//
+//     cc -O2 -pthread -I../common -o ring_stress ring_stress.c ../common/ring.c
+//     ./ring_stress [items [capacity]]
+//
+// one thread puts LSM6_READINGs numbered 0, 1, 2, ... (default 5000000) into a ring of capacity
+// items (default LSM6_DRDY_RING), the way the data ready interrupt does, and the main thread takes
+// them out and checks every field of each one arrived whole and in order. both yield when the
+// ring is full or empty, so it spends a lot of time at both ends, and the 16 bit head and tail
+// wrap many times. the exit status is 1 if any reading was wrong.
+//
+// the ring only has a compiler barrier, which is enough on the PIC32's single core and on x86,
+// where stores are seen in the order they were made. on a weakly ordered host, like ARM, a
+// failure here does not mean the firmware is wrong
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "lsm6ds33.h"
+#include "ring.h"
+
+static RING ring;
+static unsigned long items = 5000000;
+
+// every field is a different function of n, so a reading torn between two puts shows
+static void fill(LSM6_READING *r, unsigned long n) {
+    int k;
+
+    r->time = n;
+    r->tap = n * 7;
+    r->temp = n ^ 0x5555;
+    for (k = 0; k < 3; k++) {
+        r->gyro[k] = n * 3 + k;
+        r->accel[k] = n ^ (k << 12);
+    }
+}
+
+static void *producer(void *arg) {
+    LSM6_READING r;
+    unsigned long n = 0;
+
+    (void)arg;
+    while (n < items) {
+        fill(&r, n);
+        if (ring_put(&ring, &r)) {
+            n++;
+        } else {
+            sched_yield(); // full
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    unsigned long capacity = LSM6_DRDY_RING, n = 0, bad = 0, empty = 0;
+    LSM6_READING *buffer, got, want;
+    pthread_t thread;
+    int k, wrong;
+
+    if (argc > 1) {
+        items = strtoul(argv[1], 0, 0);
+    }
+    if (argc > 2) {
+        capacity = strtoul(argv[2], 0, 0);
+    }
+    if (capacity < 1 || capacity > 32768 || (capacity & (capacity - 1))) {
+        fprintf(stderr, "capacity must be a power of two up to 32768\n");
+        return 2;
+    }
+    buffer = malloc(capacity * sizeof(LSM6_READING));
+    ring_init(&ring, buffer, sizeof(LSM6_READING), capacity);
+    pthread_create(&thread, 0, producer, 0);
+
+    while (n < items) {
+        if (!ring_get(&ring, &got)) {
+            empty++;
+            sched_yield();
+            continue;
+        }
+        fill(&want, n);
+        wrong = got.time != want.time || got.tap != want.tap || got.temp != want.temp;
+        for (k = 0; k < 3; k++) {
+            wrong |= got.gyro[k] != want.gyro[k] || got.accel[k] != want.accel[k];
+        }
+        if (wrong && bad++ < 10) {
+            printf("reading %lu came out as %u\n", n, got.time);
+        }
+        n++;
+    }
+    pthread_join(thread, 0);
+
+    printf("%lu readings through a ring of %lu, %lu wrong, ring empty %lu times, %u left\n",
+        n, capacity, bad, empty, ring_count(&ring));
+    free(buffer);
+    return bad != 0 || ring_count(&ring) != 0;
+}